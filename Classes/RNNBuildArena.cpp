@@ -0,0 +1,242 @@
+//
+//  RNNBuildArena.cpp
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RNNBuildArena.h"
+#include "RNNThreadSlots.h"
+
+namespace RN
+{
+	namespace navigation
+	{
+		// Every allocation is prefixed by a header, so rcFree can tell arena and heap memory apart.
+		// It is 16 bytes to keep the alignment malloc would give.
+		struct AllocationHeader
+		{
+			BuildArena *arena;
+			size_t size;
+		};
+		
+		static const size_t AllocationHeaderSize = 16;
+		static_assert(sizeof(AllocationHeader) <= AllocationHeaderSize, "AllocationHeader too large");
+		
+		static const size_t DefaultBlockSize = 4 * 1024 * 1024;
+		static const size_t MaxRetainedSize = 16 * 1024 * 1024;
+		static const size_t MaxPooledArenas = 2;
+		
+		static RNN_THREAD_LOCAL BuildArena *_threadArena = nullptr;
+		static RNN_THREAD_LOCAL bool _threadPersistent = false;
+		
+		std::mutex BuildArena::_poolLock;
+		std::vector<BuildArena *> BuildArena::_pool;
+		
+		// Installed before anything in the module can allocate through Recast
+		bool BuildArena::_allocatorInstalled = BuildArena::InstallAllocator();
+		
+		bool BuildArena::InstallAllocator()
+		{
+			rcAllocSetCustom(&BuildArena::RecastAllocate, &BuildArena::RecastFree);
+			return true;
+		}
+		
+		BuildArena::Scope::Scope() :
+		_arena(AcquireArena()), _previous(_threadArena), _previousPersistent(_threadPersistent)
+		{
+			_threadArena = _arena;
+			_threadPersistent = false;
+		}
+		
+		BuildArena::Scope::~Scope()
+		{
+			_threadArena = _previous;
+			_threadPersistent = _previousPersistent;
+			
+			ReleaseArena(_arena);
+		}
+		
+		BuildArena::PersistentScope::PersistentScope() :
+		_previous(_threadPersistent)
+		{
+			_threadPersistent = true;
+		}
+		
+		BuildArena::PersistentScope::~PersistentScope()
+		{
+			_threadPersistent = _previous;
+		}
+		
+		
+		BuildArena::BuildArena(size_t blockSize) :
+		_blockSize(blockSize), _currentBlock(0), _usedSize(0), _peakSize(0)
+		{}
+		
+		BuildArena::~BuildArena()
+		{
+			for(Block &block : _blocks)
+				free(block.data);
+		}
+		
+		void *BuildArena::Allocate(size_t size)
+		{
+			size_t required = (AllocationHeaderSize + size + 15) & ~static_cast<size_t>(15);
+			
+			while(_currentBlock < _blocks.size() && _blocks[_currentBlock].size - _blocks[_currentBlock].used < required)
+				_currentBlock ++;
+			
+			if(_currentBlock == _blocks.size())
+			{
+				Block block;
+				block.size = std::max(_blockSize, required);
+				block.data = static_cast<uint8 *>(malloc(block.size));
+				block.used = 0;
+				
+				if(!block.data)
+					return nullptr;
+				
+				_blocks.push_back(block);
+			}
+			
+			Block &block = _blocks[_currentBlock];
+			uint8 *data = block.data + block.used;
+			
+			block.used += required;
+			_usedSize += required;
+			_peakSize = std::max(_peakSize, _usedSize);
+			
+			AllocationHeader *header = reinterpret_cast<AllocationHeader *>(data);
+			header->arena = this;
+			header->size = required;
+			
+			return data + AllocationHeaderSize;
+		}
+		
+		void BuildArena::Free(void *pointer)
+		{
+			uint8 *data = static_cast<uint8 *>(pointer) - AllocationHeaderSize;
+			AllocationHeader *header = reinterpret_cast<AllocationHeader *>(data);
+			
+			// Recast mostly frees its scratch memory in reverse order, which can be given back right away
+			if(_currentBlock < _blocks.size())
+			{
+				Block &block = _blocks[_currentBlock];
+				if(data + header->size == block.data + block.used)
+				{
+					block.used -= header->size;
+					_usedSize -= header->size;
+				}
+			}
+		}
+		
+		void BuildArena::Reset()
+		{
+			size_t retained = 0;
+			size_t count = 0;
+			
+			for(; count < _blocks.size() && retained + _blocks[count].size <= MaxRetainedSize; count ++)
+			{
+				_blocks[count].used = 0;
+				retained += _blocks[count].size;
+			}
+			
+			for(size_t i = count; i < _blocks.size(); i ++)
+				free(_blocks[i].data);
+			
+			_blocks.resize(count);
+			_currentBlock = 0;
+			_usedSize = 0;
+		}
+		
+		BuildArena *BuildArena::AcquireArena()
+		{
+			std::lock_guard<std::mutex> lock(_poolLock);
+			
+			if(_pool.empty())
+				return new BuildArena(DefaultBlockSize);
+			
+			BuildArena *arena = _pool.back();
+			_pool.pop_back();
+			
+			return arena;
+		}
+		
+		void BuildArena::ReleaseArena(BuildArena *arena)
+		{
+			arena->Reset();
+			
+			{
+				std::lock_guard<std::mutex> lock(_poolLock);
+				if(_pool.size() < MaxPooledArenas)
+				{
+					_pool.push_back(arena);
+					return;
+				}
+			}
+			
+			// More builds ran at once than usual, don't keep their memory around
+			delete arena;
+		}
+		
+		void BuildArena::Trim()
+		{
+			std::vector<BuildArena *> pool;
+			
+			{
+				std::lock_guard<std::mutex> lock(_poolLock);
+				std::swap(pool, _pool);
+			}
+			
+			for(BuildArena *arena : pool)
+				delete arena;
+		}
+		
+		void *BuildArena::RecastAllocate(int size, rcAllocHint hint)
+		{
+			BuildArena *arena = _threadArena;
+			
+			if(arena && (hint == RC_ALLOC_TEMP || !_threadPersistent))
+				return arena->Allocate(static_cast<size_t>(size));
+			
+			uint8 *data = static_cast<uint8 *>(malloc(AllocationHeaderSize + static_cast<size_t>(size)));
+			if(!data)
+				return nullptr;
+			
+			AllocationHeader *header = reinterpret_cast<AllocationHeader *>(data);
+			header->arena = nullptr;
+			header->size = static_cast<size_t>(size);
+			
+			return data + AllocationHeaderSize;
+		}
+		
+		void BuildArena::RecastFree(void *pointer)
+		{
+			if(!pointer)
+				return;
+			
+			uint8 *data = static_cast<uint8 *>(pointer) - AllocationHeaderSize;
+			AllocationHeader *header = reinterpret_cast<AllocationHeader *>(data);
+			
+			if(!header->arena)
+			{
+				free(data);
+				return;
+			}
+			
+			// Arena memory freed on another thread or after its build simply stays until the arena resets
+			if(header->arena == _threadArena)
+				header->arena->Free(pointer);
+		}
+	}
+}
@@ -0,0 +1,107 @@
+//
+//  RNNBuildArena.h
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __rayne_navigation__RNNBuildArena__
+#define __rayne_navigation__RNNBuildArena__
+
+#include <Rayne/Rayne.h>
+
+#include <mutex>
+#include <vector>
+
+#include "Recast.h"
+
+namespace RN
+{
+	namespace navigation
+	{
+		/// Bump allocator for Recast build intermediates. The module installs its own Recast allocator,
+		/// while a Scope is alive on a thread all Recast allocations of that thread go into the scope's
+		/// arena and are released at once when it ends, rcFree only rewinds the most recent allocation.
+		/// Everything allocated outside of a scope, or as RC_ALLOC_PERM inside a PersistentScope, is a
+		/// regular heap allocation and has to be freed as usual. Arena memory must not be freed after
+		/// its scope ended.
+		class BuildArena
+		{
+		public:
+			/// Takes an arena from the shared pool and makes it the current thread's one.
+			class Scope
+			{
+			public:
+				Scope();
+				~Scope();
+				
+				BuildArena *GetArena() const { return _arena; }
+				
+			private:
+				BuildArena *_arena;
+				BuildArena *_previous;
+				bool _previousPersistent;
+			};
+			
+			/// For results that outlive the build, only their temporary allocations go into the arena.
+			class PersistentScope
+			{
+			public:
+				PersistentScope();
+				~PersistentScope();
+				
+			private:
+				bool _previous;
+			};
+			
+			/// Frees all pooled arenas, for example after loading a level. Scopes still work afterwards.
+			static void Trim();
+			
+			BuildArena(size_t blockSize);
+			~BuildArena();
+			
+			void *Allocate(size_t size);
+			void Free(void *pointer);
+			void Reset();
+			
+			size_t GetPeakSize() const { return _peakSize; }
+			
+		private:
+			struct Block
+			{
+				uint8 *data;
+				size_t size;
+				size_t used;
+			};
+			
+			static BuildArena *AcquireArena();
+			static void ReleaseArena(BuildArena *arena);
+			
+			static bool InstallAllocator();
+			static void *RecastAllocate(int size, rcAllocHint hint);
+			static void RecastFree(void *pointer);
+			
+			size_t _blockSize;
+			std::vector<Block> _blocks;
+			size_t _currentBlock;
+			size_t _usedSize;
+			size_t _peakSize;
+			
+			static std::mutex _poolLock;
+			static std::vector<BuildArena *> _pool;
+			static bool _allocatorInstalled;
+		};
+	}
+}
+
+#endif /* defined(__rayne_navigation__RNNBuildArena__) */
@@ -0,0 +1,29 @@
+//
+//  RNNDetourConfig.h
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __rayne_navigation__RNNDetourConfig__
+#define __rayne_navigation__RNNDetourConfig__
+
+// Included by every module header before any Detour header. NavigationWorld overlays polygon
+// data through its own query filter, so dtQueryFilter has virtual methods. Consumers see the
+// same class layout as the module and the Detour sources, which are built with the same define.
+// Anything including Detour headers directly has to include this first or define it as well.
+#ifndef DT_VIRTUAL_QUERYFILTER
+#define DT_VIRTUAL_QUERYFILTER 1
+#endif
+
+#endif /* defined(__rayne_navigation__RNNDetourConfig__) */
@@ -0,0 +1,93 @@
+//
+//  RNNEpoch.cpp
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RNNEpoch.h"
+
+namespace RN
+{
+	namespace navigation
+	{
+		EpochDomain::EpochDomain() :
+		_epoch(1)
+		{}
+		
+		EpochDomain::~EpochDomain()
+		{
+			_readers.ForEach([](const Reader &reader) {
+				RN_ASSERT(reader.depth == 0, "EpochDomain destroyed inside a read section.");
+			});
+			
+			for(auto &retired : _retired)
+				retired.second();
+		}
+		
+		void EpochDomain::Enter()
+		{
+			Reader *reader = _readers.Get();
+			
+			// Both the store and the following load of the protected pointer are sequentially consistent,
+			// so a reader that announces an epoch at or after a retirement can only see the new data.
+			if(reader->depth ++ == 0)
+				reader->epoch.store(_epoch.load());
+		}
+		
+		void EpochDomain::Leave()
+		{
+			Reader *reader = _readers.Get();
+			
+			if(-- reader->depth == 0)
+				reader->epoch.store(0, std::memory_order_release);
+		}
+		
+		void EpochDomain::Retire(std::function<void ()> deleter)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			// The data has already been unpublished, so everyone entering from now on sees the replacement
+			uint64 epoch = _epoch.fetch_add(1) + 1;
+			_retired.emplace_back(epoch, std::move(deleter));
+		}
+		
+		void EpochDomain::Reclaim()
+		{
+			std::vector<std::function<void ()>> reclaimable;
+			
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				
+				uint64 oldest = _epoch.load();
+				_readers.ForEach([&](const Reader &reader) {
+					uint64 epoch = reader.epoch.load();
+					if(epoch != 0 && epoch < oldest)
+						oldest = epoch;
+				});
+				
+				auto iterator = std::partition(_retired.begin(), _retired.end(), [&](const std::pair<uint64, std::function<void ()>> &retired) {
+					return (retired.first > oldest);
+				});
+				
+				for(auto i = iterator; i != _retired.end(); i ++)
+					reclaimable.push_back(std::move(i->second));
+				
+				_retired.erase(iterator, _retired.end());
+			}
+			
+			for(auto &deleter : reclaimable)
+				deleter();
+		}
+	}
+}
@@ -0,0 +1,92 @@
+//
+//  RNNEpoch.h
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __rayne_navigation__RNNEpoch__
+#define __rayne_navigation__RNNEpoch__
+
+#include <Rayne/Rayne.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "RNNThreadSlots.h"
+
+namespace RN
+{
+	namespace navigation
+	{
+		/// Epoch based reclamation for data that is read lock-free while a writer replaces it.
+		/// The writer publishes the new data first and then retires the old one, which is
+		/// destroyed once no reader that could still see it is inside a read section. Every thread
+		/// has one reader slot per domain, read sections on the same thread nest. Retired data is
+		/// reclaimed by the writer on the next retirement, hosts that update rarely can also call
+		/// Reclaim() from their tick. Readers never reclaim, so a read section never frees memory.
+		class EpochDomain
+		{
+		public:
+			class ReadGuard
+			{
+			public:
+				ReadGuard(EpochDomain *domain) :
+				_domain(domain)
+				{
+					_domain->Enter();
+				}
+				
+				~ReadGuard()
+				{
+					_domain->Leave();
+				}
+				
+			private:
+				EpochDomain *_domain;
+			};
+			
+			EpochDomain();
+			~EpochDomain();
+			
+			void Enter();
+			void Leave();
+			
+			void Retire(std::function<void ()> deleter);
+			void Reclaim();
+			
+		private:
+			/// Only written by its thread, Reclaim() reads the epoch.
+			struct Reader
+			{
+				Reader() :
+				epoch(0), depth(0)
+				{}
+				
+				std::atomic<uint64> epoch;
+				uint32 depth;
+			};
+			
+			std::atomic<uint64> _epoch;
+			ThreadSlots<Reader> _readers;
+			
+			std::mutex _lock;
+			std::vector<std::pair<uint64, std::function<void ()>>> _retired;
+		};
+	}
+}
+
+#endif /* defined(__rayne_navigation__RNNEpoch__) */
@@ -0,0 +1,464 @@
+//
+//  RNNLandmarks.cpp
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RNNLandmarks.h"
+#include "DetourCommon.h"
+
+#include <limits>
+#include <queue>
+
+namespace RN
+{
+	namespace navigation
+	{
+		static const uint16 UnreachableDistance = 0xffff;
+		static const uint32 TableMagic = 'L'<<24 | 'M'<<16 | 'R'<<8 | 'K';
+		static const uint32 TableVersion = 1;
+		static const uint32 MaxLandmarkCount = 256;
+		
+		const uint32 LandmarkTable::InvalidIndex;
+		const uint32 LandmarkSearch::InvalidNode;
+		
+		typedef std::pair<float, uint32> QueueEntry;
+		typedef std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> Queue;
+		
+		LandmarkTable::LandmarkTable() :
+		_navigationMesh(nullptr), _versionHash(0), _polygonCount(0), _landmarkCount(0), _scale(0.0f)
+		{}
+		
+		void LandmarkTable::GetCentroid(const dtMeshTile *tile, const dtPoly *poly, float *centroid)
+		{
+			centroid[0] = centroid[1] = centroid[2] = 0.0f;
+			
+			for(unsigned char i = 0; i < poly->vertCount; i++)
+				dtVadd(centroid, centroid, &tile->verts[poly->verts[i] * 3]);
+			
+			dtVscale(centroid, centroid, 1.0f / poly->vertCount);
+		}
+		
+		uint32 LandmarkTable::GetPolygonIndex(dtPolyRef polygon) const
+		{
+			unsigned int tile = _navigationMesh->decodePolyIdTile(polygon);
+			unsigned int poly = _navigationMesh->decodePolyIdPoly(polygon);
+			
+			if(tile >= _tileOffsets.size() || _tileOffsets[tile] == InvalidIndex)
+				return InvalidIndex;
+			
+			uint32 index = _tileOffsets[tile] + poly;
+			return (index < _polygonCount) ? index : InvalidIndex;
+		}
+		
+		float LandmarkTable::GetLowerBound(uint32 from, uint32 to) const
+		{
+			const uint16 *fromDistances = &_distances[from * _landmarkCount];
+			const uint16 *toDistances = &_distances[to * _landmarkCount];
+			
+			int bound = 0;
+			
+			for(uint32 i = 0; i < _landmarkCount; i++)
+			{
+				if(fromDistances[i] == UnreachableDistance || toDistances[i] == UnreachableDistance)
+					continue;
+				
+				// Both values are rounded down, so the difference can be one step too large
+				int difference = std::abs(static_cast<int>(fromDistances[i]) - static_cast<int>(toDistances[i])) - 1;
+				bound = std::max(bound, difference);
+			}
+			
+			return bound * _scale;
+		}
+		
+		std::shared_ptr<LandmarkTable> LandmarkTable::Build(const dtNavMesh *navigationMesh, uint64 versionHash, size_t landmarkCount)
+		{
+			std::shared_ptr<LandmarkTable> table(new LandmarkTable());
+			table->_navigationMesh = navigationMesh;
+			table->_versionHash = versionHash;
+			table->_tileOffsets.resize(navigationMesh->getMaxTiles(), InvalidIndex);
+			
+			std::vector<dtPolyRef> polygons;
+			
+			for(int i = 0; i < navigationMesh->getMaxTiles(); i++)
+			{
+				const dtMeshTile *tile = navigationMesh->getTile(i);
+				if(!tile || !tile->header)
+					continue;
+				
+				table->_tileOffsets[i] = static_cast<uint32>(polygons.size());
+				
+				dtPolyRef base = navigationMesh->getPolyRefBase(tile);
+				for(int j = 0; j < tile->header->polyCount; j++)
+					polygons.push_back(base | static_cast<dtPolyRef>(j));
+			}
+			
+			table->_polygonCount = static_cast<uint32>(polygons.size());
+			table->_landmarkCount = static_cast<uint32>(std::min(std::min(landmarkCount, polygons.size()), static_cast<size_t>(MaxLandmarkCount)));
+			
+			if(table->_landmarkCount == 0)
+				return table;
+			
+			std::vector<float> centroids(polygons.size() * 3);
+			for(size_t i = 0; i < polygons.size(); i++)
+			{
+				const dtMeshTile *tile;
+				const dtPoly *poly;
+				navigationMesh->getTileAndPolyByRefUnsafe(polygons[i], &tile, &poly);
+				
+				GetCentroid(tile, poly, &centroids[i * 3]);
+			}
+			
+			const float infinity = std::numeric_limits<float>::infinity();
+			
+			auto dijkstra = [&](uint32 source, std::vector<float> &distances) {
+				distances.assign(polygons.size(), infinity);
+				distances[source] = 0.0f;
+				
+				Queue queue;
+				queue.push(QueueEntry(0.0f, source));
+				
+				while(!queue.empty())
+				{
+					QueueEntry entry = queue.top();
+					queue.pop();
+					
+					if(entry.first > distances[entry.second])
+						continue;
+					
+					const dtMeshTile *tile;
+					const dtPoly *poly;
+					navigationMesh->getTileAndPolyByRefUnsafe(polygons[entry.second], &tile, &poly);
+					
+					for(unsigned int link = poly->firstLink; link != DT_NULL_LINK; link = tile->links[link].next)
+					{
+						uint32 neighbour = table->GetPolygonIndex(tile->links[link].ref);
+						if(neighbour == InvalidIndex)
+							continue;
+						
+						float distance = entry.first + dtVdist(&centroids[entry.second * 3], &centroids[neighbour * 3]);
+						if(distance < distances[neighbour])
+						{
+							distances[neighbour] = distance;
+							queue.push(QueueEntry(distance, neighbour));
+						}
+					}
+				}
+			};
+			
+			// Farthest point selection, polygons no landmark reaches yet count as the farthest
+			std::vector<std::vector<float>> distances(table->_landmarkCount);
+			std::vector<float> closestLandmark(polygons.size(), infinity);
+			std::vector<float> scratch;
+			
+			dijkstra(0, scratch);
+			closestLandmark = scratch;
+			
+			for(uint32 i = 0; i < table->_landmarkCount; i++)
+			{
+				uint32 landmark = 0;
+				for(uint32 j = 1; j < polygons.size(); j++)
+				{
+					if(closestLandmark[j] > closestLandmark[landmark])
+						landmark = j;
+				}
+				
+				dijkstra(landmark, distances[i]);
+				
+				for(uint32 j = 0; j < polygons.size(); j++)
+					closestLandmark[j] = (i == 0) ? distances[i][j] : std::min(closestLandmark[j], distances[i][j]);
+			}
+			
+			float maxDistance = 0.0f;
+			for(const std::vector<float> &landmarkDistances : distances)
+			{
+				for(float distance : landmarkDistances)
+				{
+					if(distance != infinity)
+						maxDistance = std::max(maxDistance, distance);
+				}
+			}
+			
+			table->_scale = std::max(maxDistance, 1.0f) / (UnreachableDistance - 1);
+			table->_distances.resize(polygons.size() * table->_landmarkCount);
+			
+			for(uint32 i = 0; i < polygons.size(); i++)
+			{
+				for(uint32 j = 0; j < table->_landmarkCount; j++)
+				{
+					float distance = distances[j][i];
+					table->_distances[i * table->_landmarkCount + j] = (distance == infinity) ? UnreachableDistance : static_cast<uint16>(std::min(floorf(distance / table->_scale), static_cast<float>(UnreachableDistance - 1)));
+				}
+			}
+			
+			return table;
+		}
+		
+		bool LandmarkTable::Write(FILE *file) const
+		{
+			uint32 tileCount = static_cast<uint32>(_tileOffsets.size());
+			
+			bool success = (fwrite(&TableMagic, sizeof(TableMagic), 1, file) == 1);
+			success = success && (fwrite(&TableVersion, sizeof(TableVersion), 1, file) == 1);
+			success = success && (fwrite(&tileCount, sizeof(tileCount), 1, file) == 1);
+			success = success && (fwrite(&_polygonCount, sizeof(_polygonCount), 1, file) == 1);
+			success = success && (fwrite(&_landmarkCount, sizeof(_landmarkCount), 1, file) == 1);
+			success = success && (fwrite(&_scale, sizeof(_scale), 1, file) == 1);
+			success = success && (fwrite(_tileOffsets.data(), sizeof(uint32), tileCount, file) == tileCount);
+			success = success && (fwrite(_distances.data(), sizeof(uint16), _distances.size(), file) == _distances.size());
+			
+			return success;
+		}
+		
+		std::shared_ptr<LandmarkTable> LandmarkTable::Read(FILE *file, const dtNavMesh *navigationMesh, uint64 versionHash)
+		{
+			uint32 magic;
+			uint32 version;
+			uint32 tileCount;
+			
+			std::shared_ptr<LandmarkTable> table(new LandmarkTable());
+			table->_navigationMesh = navigationMesh;
+			table->_versionHash = versionHash;
+			
+			bool success = (fread(&magic, sizeof(magic), 1, file) == 1) && magic == TableMagic;
+			success = success && (fread(&version, sizeof(version), 1, file) == 1) && version == TableVersion;
+			success = success && (fread(&tileCount, sizeof(tileCount), 1, file) == 1) && tileCount == static_cast<uint32>(navigationMesh->getMaxTiles());
+			success = success && (fread(&table->_polygonCount, sizeof(uint32), 1, file) == 1);
+			success = success && (fread(&table->_landmarkCount, sizeof(uint32), 1, file) == 1);
+			success = success && (fread(&table->_scale, sizeof(float), 1, file) == 1);
+			
+			if(!success)
+				return nullptr;
+			
+			// Nothing from the file is trusted for allocations, the layout has to match the one Build() gives this mesh
+			std::vector<uint32> tileOffsets(tileCount, InvalidIndex);
+			uint32 polygonCount = 0;
+			
+			for(uint32 i = 0; i < tileCount; i++)
+			{
+				const dtMeshTile *tile = navigationMesh->getTile(i);
+				if(!tile || !tile->header)
+					continue;
+				
+				tileOffsets[i] = polygonCount;
+				polygonCount += tile->header->polyCount;
+			}
+			
+			if(table->_polygonCount != polygonCount || table->_landmarkCount > std::min(polygonCount, MaxLandmarkCount) || !(table->_scale > 0.0f))
+				return nullptr;
+			
+			table->_tileOffsets.resize(tileCount);
+			
+			if(fread(table->_tileOffsets.data(), sizeof(uint32), tileCount, file) != tileCount || table->_tileOffsets != tileOffsets)
+				return nullptr;
+			
+			table->_distances.resize(static_cast<size_t>(table->_polygonCount) * table->_landmarkCount);
+			
+			success = (fread(table->_distances.data(), sizeof(uint16), table->_distances.size(), file) == table->_distances.size());
+			return success ? table : nullptr;
+		}
+		
+		
+		LandmarkSearch::LandmarkSearch(uint32 maxNodes) :
+		_maxNodes(std::max(maxNodes, static_cast<uint32>(1))), _nodeCount(0)
+		{
+			_nodes.resize(_maxNodes);
+			_buckets.resize(dtNextPow2(std::max(_maxNodes / 4, static_cast<uint32>(1))), InvalidNode);
+		}
+		
+		uint32 LandmarkSearch::GetBucket(dtPolyRef polygon) const
+		{
+			return (static_cast<uint32>(polygon) * 2654435761U) & (static_cast<uint32>(_buckets.size()) - 1);
+		}
+		
+		LandmarkSearch::Node *LandmarkSearch::FindNode(dtPolyRef polygon)
+		{
+			for(uint32 index = _buckets[GetBucket(polygon)]; index != InvalidNode; index = _nodes[index].next)
+			{
+				if(_nodes[index].polygon == polygon)
+					return &_nodes[index];
+			}
+			
+			return nullptr;
+		}
+		
+		LandmarkSearch::Node *LandmarkSearch::AllocateNode(dtPolyRef polygon)
+		{
+			if(_nodeCount == _maxNodes)
+				return nullptr;
+			
+			uint32 bucket = GetBucket(polygon);
+			
+			Node &node = _nodes[_nodeCount];
+			node.polygon = polygon;
+			node.next = _buckets[bucket];
+			
+			_buckets[bucket] = _nodeCount ++;
+			return &node;
+		}
+		
+		dtStatus LandmarkSearch::FindPath(const LandmarkTable &table, const dtNavMesh *navigationMesh, const dtQueryFilter *filter, dtPolyRef start, dtPolyRef target, dtPolyRef *path, int *pathCount, int maxPath)
+		{
+			*pathCount = 0;
+			
+			// Only the buckets need clearing, nodes are initialised when they are handed out
+			std::fill(_buckets.begin(), _buckets.end(), InvalidNode);
+			_nodeCount = 0;
+			
+			uint32 targetIndex = table.GetPolygonIndex(target);
+			
+			if(table.GetPolygonIndex(start) == LandmarkTable::InvalidIndex || targetIndex == LandmarkTable::InvalidIndex || maxPath <= 0)
+				return DT_FAILURE | DT_INVALID_PARAM;
+			
+			auto visit = [&](uint32 polygonIndex, dtPolyRef polygon, const dtMeshTile *tile, const dtPoly *poly) -> Node * {
+				Node *node = FindNode(polygon);
+				if(node)
+					return node;
+				
+				node = AllocateNode(polygon);
+				if(node)
+				{
+					node->polygonIndex = polygonIndex;
+					node->parent = InvalidNode;
+					node->cost = std::numeric_limits<float>::infinity();
+					node->closed = false;
+					LandmarkTable::GetCentroid(tile, poly, node->centroid);
+				}
+				
+				return node;
+			};
+			
+			const dtMeshTile *tile;
+			const dtPoly *poly;
+			
+			navigationMesh->getTileAndPolyByRefUnsafe(target, &tile, &poly);
+			float targetCentroid[3];
+			LandmarkTable::GetCentroid(tile, poly, targetCentroid);
+			
+			auto heuristic = [&](const Node *node) {
+				return std::max(dtVdist(node->centroid, targetCentroid), table.GetLowerBound(node->polygonIndex, targetIndex));
+			};
+			
+			navigationMesh->getTileAndPolyByRefUnsafe(start, &tile, &poly);
+			Node *startNode = visit(table.GetPolygonIndex(start), start, tile, poly);
+			startNode->cost = 0.0f;
+			
+			Queue open;
+			open.push(QueueEntry(heuristic(startNode), 0));
+			
+			// Like Detour, an unreachable target yields the corridor to the polygon closest to it
+			uint32 best = 0;
+			float bestHeuristic = std::numeric_limits<float>::infinity();
+			bool found = false;
+			bool outOfNodes = false;
+			
+			while(!open.empty())
+			{
+				uint32 index = open.top().second;
+				open.pop();
+				
+				Node &node = _nodes[index];
+				if(node.closed)
+					continue;
+				
+				node.closed = true;
+				
+				if(node.polygon == target)
+				{
+					best = index;
+					found = true;
+					break;
+				}
+				
+				float remaining = dtVdist(node.centroid, targetCentroid);
+				if(remaining < bestHeuristic)
+				{
+					bestHeuristic = remaining;
+					best = index;
+				}
+				
+				const dtMeshTile *currentTile;
+				const dtPoly *currentPoly;
+				navigationMesh->getTileAndPolyByRefUnsafe(node.polygon, &currentTile, &currentPoly);
+				
+				dtPolyRef parentPolygon = (node.parent != InvalidNode) ? _nodes[node.parent].polygon : 0;
+				
+				for(unsigned int link = currentPoly->firstLink; link != DT_NULL_LINK; link = currentTile->links[link].next)
+				{
+					dtPolyRef neighbourPolygon = currentTile->links[link].ref;
+					if(!neighbourPolygon || neighbourPolygon == parentPolygon)
+						continue;
+					
+					uint32 neighbourIndex = table.GetPolygonIndex(neighbourPolygon);
+					if(neighbourIndex == LandmarkTable::InvalidIndex)
+						continue;
+					
+					const dtMeshTile *neighbourTile;
+					const dtPoly *neighbourPoly;
+					navigationMesh->getTileAndPolyByRefUnsafe(neighbourPolygon, &neighbourTile, &neighbourPoly);
+					
+					if(!filter->passFilter(neighbourPolygon, neighbourTile, neighbourPoly))
+						continue;
+					
+					Node *neighbour = visit(neighbourIndex, neighbourPolygon, neighbourTile, neighbourPoly);
+					if(!neighbour)
+					{
+						outOfNodes = true;
+						continue;
+					}
+					
+					if(neighbour->closed)
+						continue;
+					
+					float cost = node.cost + filter->getCost(node.centroid, neighbour->centroid, parentPolygon, nullptr, nullptr, node.polygon, currentTile, currentPoly, neighbourPolygon, neighbourTile, neighbourPoly);
+					if(cost < neighbour->cost)
+					{
+						neighbour->cost = cost;
+						neighbour->parent = index;
+						open.push(QueueEntry(cost + heuristic(neighbour), static_cast<uint32>(neighbour - _nodes.data())));
+					}
+				}
+			}
+			
+			dtStatus status = DT_SUCCESS;
+			
+			if(!found)
+				status |= DT_PARTIAL_RESULT;
+			if(outOfNodes)
+				status |= DT_OUT_OF_NODES;
+			
+			int length = 0;
+			for(uint32 index = best; index != InvalidNode; index = _nodes[index].parent)
+				length ++;
+			
+			// Like Detour, keep the beginning of the corridor if it does not fit
+			int skip = 0;
+			if(length > maxPath)
+			{
+				skip = length - maxPath;
+				status |= DT_BUFFER_TOO_SMALL;
+			}
+			
+			int position = length - 1;
+			for(uint32 index = best; index != InvalidNode; index = _nodes[index].parent, position --)
+			{
+				if(position < maxPath)
+					path[position] = _nodes[index].polygon;
+			}
+			
+			*pathCount = length - skip;
+			return status;
+		}
+	}
+}
@@ -0,0 +1,114 @@
+//
+//  RNNLandmarks.h
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __rayne_navigation__RNNLandmarks__
+#define __rayne_navigation__RNNLandmarks__
+
+#include <Rayne/Rayne.h>
+
+#include <memory>
+#include <vector>
+
+#include "RNNDetourConfig.h"
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+namespace RN
+{
+	namespace navigation
+	{
+		/// Distances from a few landmark polygons to every polygon of a navigation mesh, for the ALT
+		/// lower bound |d(L, target) - d(L, n)| <= d(n, target). Distances are measured between polygon
+		/// centroids without area costs and quantized to 16 bit, rounding is accounted for in the bound.
+		/// The bound stays admissible for any filter that only excludes polygons and has area costs >= 1.
+		class LandmarkTable
+		{
+		public:
+			static const uint32 InvalidIndex = 0xffffffff;
+			
+			static std::shared_ptr<LandmarkTable> Build(const dtNavMesh *navigationMesh, uint64 versionHash, size_t landmarkCount);
+			static std::shared_ptr<LandmarkTable> Read(FILE *file, const dtNavMesh *navigationMesh, uint64 versionHash);
+			bool Write(FILE *file) const;
+			
+			bool IsValidFor(const dtNavMesh *navigationMesh, uint64 versionHash) const { return (_navigationMesh == navigationMesh && _versionHash == versionHash); }
+			
+			uint32 GetPolygonIndex(dtPolyRef polygon) const;
+			uint32 GetPolygonCount() const { return _polygonCount; }
+			uint32 GetLandmarkCount() const { return _landmarkCount; }
+			
+			float GetLowerBound(uint32 from, uint32 to) const;
+			size_t GetMemorySize() const { return sizeof(LandmarkTable) + _tileOffsets.size() * sizeof(uint32) + _distances.size() * sizeof(uint16); }
+			
+			static void GetCentroid(const dtMeshTile *tile, const dtPoly *poly, float *centroid);
+			
+		private:
+			LandmarkTable();
+			
+			const dtNavMesh *_navigationMesh;
+			uint64 _versionHash;
+			
+			std::vector<uint32> _tileOffsets;
+			uint32 _polygonCount;
+			uint32 _landmarkCount;
+			float _scale;
+			
+			// Polygon major, so the rows of both ends of a query are contiguous
+			std::vector<uint16> _distances;
+		};
+		
+		/// A* over polygon centroids using the landmark bound as heuristic. Like dtNavMeshQuery it keeps
+		/// a bounded, hashed node pool between queries, Paths create one on their first landmark search.
+		class LandmarkSearch
+		{
+		public:
+			LandmarkSearch(uint32 maxNodes = 2048);
+			
+			/// Runs out of nodes like Detour does, the result is then partial and flagged DT_OUT_OF_NODES.
+			dtStatus FindPath(const LandmarkTable &table, const dtNavMesh *navigationMesh, const dtQueryFilter *filter, dtPolyRef start, dtPolyRef target, dtPolyRef *path, int *pathCount, int maxPath);
+			
+			/// Nodes touched by the last search, the same measure as dtNodePool::getNodeCount().
+			uint32 GetNodeCount() const { return _nodeCount; }
+			
+		private:
+			static const uint32 InvalidNode = 0xffffffff;
+			
+			struct Node
+			{
+				dtPolyRef polygon;
+				uint32 polygonIndex;
+				uint32 parent;
+				uint32 next;
+				float cost;
+				float centroid[3];
+				bool closed;
+			};
+			
+			uint32 GetBucket(dtPolyRef polygon) const;
+			Node *FindNode(dtPolyRef polygon);
+			Node *AllocateNode(dtPolyRef polygon);
+			
+			uint32 _maxNodes;
+			uint32 _nodeCount;
+			
+			std::vector<Node> _nodes;
+			std::vector<uint32> _buckets;
+		};
+	}
+}
+
+#endif /* defined(__rayne_navigation__RNNLandmarks__) */
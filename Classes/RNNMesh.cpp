@@ -16,6 +16,7 @@
 //
 
 #include "RNNMesh.h"
+#include "RNNQueryCapture.h"
 
 namespace RN
 {
@@ -47,6 +48,7 @@ namespace RN
 		
 		Mesh::~Mesh()
 		{
+			SetQueryCapture(nullptr);
 			Cleanup();
 		}
 		
@@ -55,6 +57,9 @@ namespace RN
 			_polyMesh = nullptr;
 			_polyMeshDetail = nullptr;
 			_navigationMesh = nullptr;
+			_versionHash = 0;
+			_publishSequence = 0;
+			_queryCapture = nullptr;
 			
 			_cellSize = 0.3f;
 			_cellHeight = 0.2f;
@@ -69,6 +74,10 @@ namespace RN
 			_vertsPerPoly = 6.0f;
 			_detailSampleDist = 6.0f;
 			_detailSampleMaxError = 1.0f;
+			_maxTiles = 64;
+			_maxTilePolygons = 0;
+			_compact = false;
+			_detailMode = FullDetail;
 			_partitionType = Watershed;
 		}
 		
@@ -82,18 +91,37 @@ namespace RN
 		bool Mesh::GenerateFromModels(RN::Array *models)
 		{
 			RN_ASSERT(models && models->GetCount(), "There must be at least one model.");
+			return Generate(models, nullptr);
+		}
+		
+		bool Mesh::GenerateFromHeightmap(const Heightmap &heightmap, RN::Array *models)
+		{
+			RN_ASSERT(heightmap.heights && heightmap.width >= 2 && heightmap.depth >= 2, "The heightmap needs at least 2x2 samples.");
+			return Generate(models, &heightmap);
+		}
+		
+		bool Mesh::Generate(RN::Array *models, const Heightmap *heightmap)
+		{
+			CleanupIntermediates();
 			
-			Cleanup();
+			// All Recast intermediates are released with the arena, no matter where the build returns.
+			BuildArena::Scope arenaScope;
+			
+			if(models && !models->GetCount())
+				models = nullptr;
 			
 			int32 numberOfVertices = 0;
 			int32 numberOfTriangles = 0;
-			models->Enumerate<RN::Model>([&](RN::Model *model, size_t index, bool stop){
-				for(int i = 0; i < model->GetMeshCount(0); i++)
-				{
-					numberOfVertices += model->GetMeshAtIndex(0, i)->GetVerticesCount();
-					numberOfTriangles += model->GetMeshAtIndex(0, i)->GetIndicesCount()/3;
-				}
-			});
+			if(models)
+			{
+				models->Enumerate<RN::Model>([&](RN::Model *model, size_t index, bool stop){
+					for(int i = 0; i < model->GetMeshCount(0); i++)
+					{
+						numberOfVertices += model->GetMeshAtIndex(0, i)->GetVerticesCount();
+						numberOfTriangles += model->GetMeshAtIndex(0, i)->GetIndicesCount()/3;
+					}
+				});
+			}
 			
 			//
 			// Step 1. Initialize build config.
@@ -118,16 +146,36 @@ namespace RN
 			// Set the area where the navigation will be build.
 			// Here the bounds of the input mesh are used, but the
 			// area could be specified by an user defined box, etc.
-			RN::AABB boundingBox;
-			models->Enumerate<RN::Model>([&](RN::Model *model, size_t index, bool stop){
-				boundingBox += model->GetBoundingBox();
-			});
-			rcVcopy(_recastConfig.bmin, &boundingBox.minExtend.x);
-			rcVcopy(_recastConfig.bmax, &boundingBox.maxExtend.x);
+			if(models)
+			{
+				RN::AABB boundingBox;
+				models->Enumerate<RN::Model>([&](RN::Model *model, size_t index, bool stop){
+					boundingBox += model->GetBoundingBox();
+				});
+				rcVcopy(_recastConfig.bmin, &boundingBox.minExtend.x);
+				rcVcopy(_recastConfig.bmax, &boundingBox.maxExtend.x);
+			}
+			if(heightmap)
+			{
+				float heightmapMin[3];
+				float heightmapMax[3];
+				heightmap->GetBounds(heightmapMin, heightmapMax);
+				
+				if(models)
+				{
+					rcVmin(_recastConfig.bmin, heightmapMin);
+					rcVmax(_recastConfig.bmax, heightmapMax);
+				}
+				else
+				{
+					rcVcopy(_recastConfig.bmin, heightmapMin);
+					rcVcopy(_recastConfig.bmax, heightmapMax);
+				}
+			}
 			rcCalcGridSize(_recastConfig.bmin, _recastConfig.bmax, _recastConfig.cs, &_recastConfig.width, &_recastConfig.height);
 			
 			//Create build context
-			BuildContext *buildContext = new BuildContext;
+			std::unique_ptr<BuildContext> buildContext(new BuildContext);
 			
 			// Reset build times gathering.
 			buildContext->resetTimers();
@@ -138,28 +186,38 @@ namespace RN
 			buildContext->log(RC_LOG_PROGRESS, "Building navigation:");
 			buildContext->log(RC_LOG_PROGRESS, " - %d x %d cells", _recastConfig.width, _recastConfig.height);
 			buildContext->log(RC_LOG_PROGRESS, " - %.1fK verts, %.1fK tris", numberOfVertices/1000.0f, numberOfTriangles/1000.0f);
+			if(heightmap)
+				buildContext->log(RC_LOG_PROGRESS, " - %d x %d heightmap samples", static_cast<int>(heightmap->width), static_cast<int>(heightmap->depth));
 			
 			//
 			// Step 2. Rasterize input polygon soup.
 			//
 			
+			// The heightfield is usually the largest intermediate and is freed once the compact heightfield exists,
+			// the arena could only release it at the end of the build. So it and its spans live on the heap.
+			std::unique_ptr<BuildArena::PersistentScope> heightfieldScope(new BuildArena::PersistentScope());
+			
 			// Allocate voxel heightfield where we rasterize our input data to.
-			rcHeightfield *heightfield = rcAllocHeightfield();
+			std::unique_ptr<rcHeightfield, void (*)(rcHeightfield *)> heightfield(rcAllocHeightfield(), &rcFreeHeightField);
 			if(!heightfield)
 			{
 				buildContext->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'solid'.");
 				return false;
 			}
-			if(!rcCreateHeightfield(buildContext, *heightfield, _recastConfig.width, _recastConfig.height, _recastConfig.bmin, _recastConfig.bmax, _recastConfig.cs, _recastConfig.ch))
+			if(!rcCreateHeightfield(buildContext.get(), *heightfield, _recastConfig.width, _recastConfig.height, _recastConfig.bmin, _recastConfig.bmax, _recastConfig.cs, _recastConfig.ch))
 			{
 				buildContext->log(RC_LOG_ERROR, "buildNavigation: Could not create solid heightfield.");
 				return false;
 			}
 			
+			// Terrain goes straight into the heightfield, props are rasterized on top and merged with it.
+			if(heightmap)
+				RasterizeHeightmap(buildContext.get(), *heightmap, *heightfield);
+			
 			// Allocate array that can hold triangle area types.
 			// If you have multiple meshes you need to process, allocate
 			// an array which can hold the max number of triangles you need to process.
-			unsigned char* triangleAreas = new unsigned char[numberOfTriangles];
+			unsigned char* triangleAreas = static_cast<unsigned char *>(rcAlloc(rcMax(numberOfTriangles, 1), RC_ALLOC_TEMP));
 			if(!triangleAreas)
 			{
 				buildContext->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'triangleAreas' (%d).", numberOfTriangles);
@@ -171,71 +229,77 @@ namespace RN
 			// the area type for each of the meshes and rasterize them.
 			memset(triangleAreas, 0, numberOfTriangles*sizeof(unsigned char));
 			
-			models->Enumerate<RN::Model>([&](RN::Model *model, size_t index, bool stop){
-				for(int i = 0; i < model->GetMeshCount(0); i++)
-				{
-					RN::Mesh *mesh = model->GetMeshAtIndex(0, i);
-					
-					
-					const MeshDescriptor *posdescriptor = mesh->GetDescriptorForFeature(MeshFeature::Vertices);
-					const MeshDescriptor *inddescriptor = mesh->GetDescriptorForFeature(MeshFeature::Indices);
-					const uint8 *pospointer = mesh->GetVerticesData<uint8>() + posdescriptor->offset;
-					
-					const Vector3 *vertex;
-					float *vertices = new float[mesh->GetVerticesCount()*3];
-					int32 *indices = new int32[mesh->GetIndicesCount()];
-					size_t stride = mesh->GetStride();
-					
-					for(int n = 0; n < mesh->GetVerticesCount(); n++)
-					{
-						vertex = reinterpret_cast<const Vector3 *>(pospointer + stride * n);
-						vertices[n*3+0] = vertex->x;
-						vertices[n*3+1] = vertex->y;
-						vertices[n*3+2] = vertex->z;
-					}
-					
-					switch(inddescriptor->elementSize)
+			if(models)
+			{
+				models->Enumerate<RN::Model>([&](RN::Model *model, size_t index, bool stop){
+					for(int i = 0; i < model->GetMeshCount(0); i++)
 					{
-						case 1:
+						RN::Mesh *mesh = model->GetMeshAtIndex(0, i);
+						
+						
+						const MeshDescriptor *posdescriptor = mesh->GetDescriptorForFeature(MeshFeature::Vertices);
+						const MeshDescriptor *inddescriptor = mesh->GetDescriptorForFeature(MeshFeature::Indices);
+						const uint8 *pospointer = mesh->GetVerticesData<uint8>() + posdescriptor->offset;
+						
+						const Vector3 *vertex;
+						float *vertices = static_cast<float *>(rcAlloc(static_cast<int>(sizeof(float) * mesh->GetVerticesCount() * 3), RC_ALLOC_TEMP));
+						int32 *indices = static_cast<int32 *>(rcAlloc(static_cast<int>(sizeof(int32) * mesh->GetIndicesCount()), RC_ALLOC_TEMP));
+						size_t stride = mesh->GetStride();
+						
+						for(int n = 0; n < mesh->GetVerticesCount(); n++)
 						{
-							const uint8 *index = mesh->GetIndicesData<uint8>();
-							for(int n = 0; n < mesh->GetIndicesCount(); n++)
-							{
-								indices[n] = (*index ++);
-							}
-							
-							break;
+							vertex = reinterpret_cast<const Vector3 *>(pospointer + stride * n);
+							vertices[n*3+0] = vertex->x;
+							vertices[n*3+1] = vertex->y;
+							vertices[n*3+2] = vertex->z;
 						}
-							
-						case 2:
+						
+						switch(inddescriptor->elementSize)
 						{
-							const uint16 *index = mesh->GetIndicesData<uint16>();
-							for(int n = 0; n < mesh->GetIndicesCount(); n++)
+							case 1:
 							{
-								indices[n] = (*index ++);
+								const uint8 *index = mesh->GetIndicesData<uint8>();
+								for(int n = 0; n < mesh->GetIndicesCount(); n++)
+								{
+									indices[n] = (*index ++);
+								}
+								
+								break;
 							}
-							
-							break;
-						}
-							
-						case 4:
-						{
-							const uint32 *index = mesh->GetIndicesData<uint32>();
-							for(int n = 0; n < mesh->GetIndicesCount(); n++)
+								
+							case 2:
 							{
-								indices[n] = (*index ++);
+								const uint16 *index = mesh->GetIndicesData<uint16>();
+								for(int n = 0; n < mesh->GetIndicesCount(); n++)
+								{
+									indices[n] = (*index ++);
+								}
+								
+								break;
+							}
+								
+							case 4:
+							{
+								const uint32 *index = mesh->GetIndicesData<uint32>();
+								for(int n = 0; n < mesh->GetIndicesCount(); n++)
+								{
+									indices[n] = (*index ++);
+								}
+								
+								break;
 							}
-							
-							break;
 						}
+						
+						rcMarkWalkableTriangles(buildContext.get(), _recastConfig.walkableSlopeAngle, vertices, static_cast<int>(mesh->GetVerticesCount()), indices, static_cast<int>(mesh->GetIndicesCount())/3, triangleAreas);
+						rcRasterizeTriangles(buildContext.get(), vertices, static_cast<int>(mesh->GetVerticesCount()), indices, triangleAreas, static_cast<int>(mesh->GetIndicesCount())/3, *heightfield, _recastConfig.walkableClimb);
+						
+						rcFree(indices);
+						rcFree(vertices);
 					}
-					
-					rcMarkWalkableTriangles(buildContext, _recastConfig.walkableSlopeAngle, vertices, static_cast<int>(mesh->GetVerticesCount()), indices, static_cast<int>(mesh->GetIndicesCount())/3, triangleAreas);
-					rcRasterizeTriangles(buildContext, vertices, static_cast<int>(mesh->GetVerticesCount()), indices, triangleAreas, static_cast<int>(mesh->GetIndicesCount())/3, *heightfield, _recastConfig.walkableClimb);
-				}
-			});
+				});
+			}
 			
-			delete [] triangleAreas;
+			rcFree(triangleAreas);
 			
 			//
 			// Step 3. Filter walkables surfaces.
@@ -244,10 +308,11 @@ namespace RN
 			// Once all geoemtry is rasterized, we do initial pass of filtering to
 			// remove unwanted overhangs caused by the conservative rasterization
 			// as well as filter spans where the character cannot possibly stand.
-			rcFilterLowHangingWalkableObstacles(buildContext, _recastConfig.walkableClimb, *heightfield);
-			rcFilterLedgeSpans(buildContext, _recastConfig.walkableHeight, _recastConfig.walkableClimb, *heightfield);
-			rcFilterWalkableLowHeightSpans(buildContext, _recastConfig.walkableHeight, *heightfield);
+			rcFilterLowHangingWalkableObstacles(buildContext.get(), _recastConfig.walkableClimb, *heightfield);
+			rcFilterLedgeSpans(buildContext.get(), _recastConfig.walkableHeight, _recastConfig.walkableClimb, *heightfield);
+			rcFilterWalkableLowHeightSpans(buildContext.get(), _recastConfig.walkableHeight, *heightfield);
 			
+			heightfieldScope.reset();
 			
 			//
 			// Step 4. Partition walkable surface to simple regions.
@@ -262,16 +327,16 @@ namespace RN
 				buildContext->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'chf'.");
 				return false;
 			}
-			if(!rcBuildCompactHeightfield(buildContext, _recastConfig.walkableHeight, _recastConfig.walkableClimb, *heightfield, *compactHeightfield))
+			if(!rcBuildCompactHeightfield(buildContext.get(), _recastConfig.walkableHeight, _recastConfig.walkableClimb, *heightfield, *compactHeightfield))
 			{
 				buildContext->log(RC_LOG_ERROR, "buildNavigation: Could not build compact data.");
 				return false;
 			}
 			
-			rcFreeHeightField(heightfield);
+			heightfield.reset();
 			
 			// Erode the walkable area by agent radius.
-			if(!rcErodeWalkableArea(buildContext, _recastConfig.walkableRadius, *compactHeightfield))
+			if(!rcErodeWalkableArea(buildContext.get(), _recastConfig.walkableRadius, *compactHeightfield))
 			{
 				buildContext->log(RC_LOG_ERROR, "buildNavigation: Could not erode.");
 				return false;
@@ -280,7 +345,7 @@ namespace RN
 			// (Optional) Mark areas.
 		/*	const ConvexVolume* vols = m_geom->getConvexVolumes();
 			for (int i  = 0; i < m_geom->getConvexVolumeCount(); ++i)
-				rcMarkConvexPolyArea(buildContext, vols[i].verts, vols[i].nverts, vols[i].hmin, vols[i].hmax, (unsigned char)vols[i].area, *_compactHeightfield);*/
+				rcMarkConvexPolyArea(buildContext.get(), vols[i].verts, vols[i].nverts, vols[i].hmin, vols[i].hmax, (unsigned char)vols[i].area, *_compactHeightfield);*/
 			
 			
 			// Partition the heightfield so that we can use simple algorithm later to triangulate the walkable areas.
@@ -312,14 +377,14 @@ namespace RN
 			if(_partitionType == PartitionType::Watershed)
 			{
 				// Prepare for region partitioning, by calculating distance field along the walkable surface.
-				if(!rcBuildDistanceField(buildContext, *compactHeightfield))
+				if(!rcBuildDistanceField(buildContext.get(), *compactHeightfield))
 				{
 					buildContext->log(RC_LOG_ERROR, "buildNavigation: Could not build distance field.");
 					return false;
 				}
 				
 				// Partition the walkable surface into simple regions without holes.
-				if(!rcBuildRegions(buildContext, *compactHeightfield, 0, _recastConfig.minRegionArea, _recastConfig.mergeRegionArea))
+				if(!rcBuildRegions(buildContext.get(), *compactHeightfield, 0, _recastConfig.minRegionArea, _recastConfig.mergeRegionArea))
 				{
 					buildContext->log(RC_LOG_ERROR, "buildNavigation: Could not build watershed regions.");
 					return false;
@@ -329,7 +394,7 @@ namespace RN
 			{
 				// Partition the walkable surface into simple regions without holes.
 				// Monotone partitioning does not need distancefield.
-				if(!rcBuildRegionsMonotone(buildContext, *compactHeightfield, 0, _recastConfig.minRegionArea, _recastConfig.mergeRegionArea))
+				if(!rcBuildRegionsMonotone(buildContext.get(), *compactHeightfield, 0, _recastConfig.minRegionArea, _recastConfig.mergeRegionArea))
 				{
 					buildContext->log(RC_LOG_ERROR, "buildNavigation: Could not build monotone regions.");
 					return false;
@@ -338,7 +403,7 @@ namespace RN
 			else // SAMPLE_PARTITION_LAYERS
 			{
 				// Partition the walkable surface into simple regions without holes.
-				if(!rcBuildLayerRegions(buildContext, *compactHeightfield, 0, _recastConfig.minRegionArea))
+				if(!rcBuildLayerRegions(buildContext.get(), *compactHeightfield, 0, _recastConfig.minRegionArea))
 				{
 					buildContext->log(RC_LOG_ERROR, "buildNavigation: Could not build layer regions.");
 					return false;
@@ -356,7 +421,7 @@ namespace RN
 				buildContext->log(RC_LOG_ERROR, "buildNavigation: Out of memory '_contourSet'.");
 				return false;
 			}
-			if(!rcBuildContours(buildContext, *compactHeightfield, _recastConfig.maxSimplificationError, _recastConfig.maxEdgeLen, *contourSet))
+			if(!rcBuildContours(buildContext.get(), *compactHeightfield, _recastConfig.maxSimplificationError, _recastConfig.maxEdgeLen, *contourSet))
 			{
 				buildContext->log(RC_LOG_ERROR, "buildNavigation: Could not create contours.");
 				return false;
@@ -366,14 +431,20 @@ namespace RN
 			// Step 6. Build polygons mesh from contours.
 			//
 			
+			// The poly meshes are kept after the build, only their scratch memory goes into the arena.
+			BuildArena::PersistentScope persistentScope;
+			
+			// Both are built off to the side and only handed to the mesh once complete, under the tile lock.
+			std::unique_ptr<rcPolyMesh, void (*)(rcPolyMesh *)> polyMesh(rcAllocPolyMesh(), &rcFreePolyMesh);
+			std::unique_ptr<rcPolyMeshDetail, void (*)(rcPolyMeshDetail *)> polyMeshDetail(nullptr, &rcFreePolyMeshDetail);
+			
 			// Build polygon navmesh from the contours.
-			_polyMesh = rcAllocPolyMesh();
-			if(!_polyMesh)
+			if(!polyMesh)
 			{
 				buildContext->log(RC_LOG_ERROR, "buildNavigation: Out of memory '_polyMesh'.");
 				return false;
 			}
-			if(!rcBuildPolyMesh(buildContext, *contourSet, _recastConfig.maxVertsPerPoly, *_polyMesh))
+			if(!rcBuildPolyMesh(buildContext.get(), *contourSet, _recastConfig.maxVertsPerPoly, *polyMesh))
 			{
 				buildContext->log(RC_LOG_ERROR, "buildNavigation: Could not triangulate contours.");
 				return false;
@@ -383,17 +454,24 @@ namespace RN
 			// Step 7. Create detail mesh which allows to access approximate height on each polygon.
 			//
 			
-			_polyMeshDetail = rcAllocPolyMeshDetail();
-			if(!_polyMeshDetail)
-			{
-				buildContext->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'pmdtl'.");
-				return false;
-			}
-			
-			if(!rcBuildPolyMeshDetail(buildContext, *_polyMesh, *compactHeightfield, _recastConfig.detailSampleDist, _recastConfig.detailSampleMaxError, *_polyMeshDetail))
+			// Without a detail mesh Detour triangulates the polygons itself and adds no vertices
+			if(_detailMode != NoDetail)
 			{
-				buildContext->log(RC_LOG_ERROR, "buildNavigation: Could not build detail mesh.");
-				return false;
+				polyMeshDetail.reset(rcAllocPolyMeshDetail());
+				if(!polyMeshDetail)
+				{
+					buildContext->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'pmdtl'.");
+					return false;
+				}
+				
+				// Simplified detail samples heights four times as sparse and tolerates four times the error
+				float detailScale = (_detailMode == SimplifiedDetail) ? 4.0f : 1.0f;
+				
+				if(!rcBuildPolyMeshDetail(buildContext.get(), *polyMesh, *compactHeightfield, _recastConfig.detailSampleDist * detailScale, _recastConfig.detailSampleMaxError * detailScale, *polyMeshDetail))
+				{
+					buildContext->log(RC_LOG_ERROR, "buildNavigation: Could not build detail mesh.");
+					return false;
+				}
 			}
 
 			rcFreeCompactHeightfield(compactHeightfield);
@@ -414,25 +492,25 @@ namespace RN
 				int navDataSize = 0;
 				
 				// Update poly flags from areas.
-				for (int i = 0; i < _polyMesh->npolys; ++i)
+				for (int i = 0; i < polyMesh->npolys; ++i)
 				{
-					_polyMesh->areas[i] = 0;
-					_polyMesh->flags[i] = 1;
+					polyMesh->areas[i] = 0;
+					polyMesh->flags[i] = 1;
 					
-					/*if(_polyMesh->areas[i] == RC_WALKABLE_AREA)
-						_polyMesh->areas[i] = SAMPLE_POLYAREA_GROUND;
+					/*if(polyMesh->areas[i] == RC_WALKABLE_AREA)
+						polyMesh->areas[i] = SAMPLE_POLYAREA_GROUND;
 					
-					if(_polyMesh->areas[i] == SAMPLE_POLYAREA_GROUND ||
-						_polyMesh->areas[i] == SAMPLE_POLYAREA_GRASS ||
-						_polyMesh->areas[i] == SAMPLE_POLYAREA_ROAD)
+					if(polyMesh->areas[i] == SAMPLE_POLYAREA_GROUND ||
+						polyMesh->areas[i] == SAMPLE_POLYAREA_GRASS ||
+						polyMesh->areas[i] == SAMPLE_POLYAREA_ROAD)
 					{
-						_polyMesh->flags[i] = SAMPLE_POLYFLAGS_WALK;
+						polyMesh->flags[i] = SAMPLE_POLYFLAGS_WALK;
 					}
-					else if(_polyMesh->areas[i] == SAMPLE_POLYAREA_WATER)
+					else if(polyMesh->areas[i] == SAMPLE_POLYAREA_WATER)
 					{
-						_polyMesh->flags[i] = SAMPLE_POLYFLAGS_SWIM;
+						polyMesh->flags[i] = SAMPLE_POLYFLAGS_SWIM;
 					}
-					else if(_polyMesh->areas[i] == SAMPLE_POLYAREA_DOOR)
+					else if(polyMesh->areas[i] == SAMPLE_POLYAREA_DOOR)
 					{
 						_polygonMesh->flags[i] = SAMPLE_POLYFLAGS_WALK | SAMPLE_POLYFLAGS_DOOR;
 					}*/
@@ -441,18 +519,21 @@ namespace RN
 				
 				dtNavMeshCreateParams params;
 				memset(&params, 0, sizeof(params));
-				params.verts = _polyMesh->verts;
-				params.vertCount = _polyMesh->nverts;
-				params.polys = _polyMesh->polys;
-				params.polyAreas = _polyMesh->areas;
-				params.polyFlags = _polyMesh->flags;
-				params.polyCount = _polyMesh->npolys;
-				params.nvp = _polyMesh->nvp;
-				params.detailMeshes = _polyMeshDetail->meshes;
-				params.detailVerts = _polyMeshDetail->verts;
-				params.detailVertsCount = _polyMeshDetail->nverts;
-				params.detailTris = _polyMeshDetail->tris;
-				params.detailTriCount = _polyMeshDetail->ntris;
+				params.verts = polyMesh->verts;
+				params.vertCount = polyMesh->nverts;
+				params.polys = polyMesh->polys;
+				params.polyAreas = polyMesh->areas;
+				params.polyFlags = polyMesh->flags;
+				params.polyCount = polyMesh->npolys;
+				params.nvp = polyMesh->nvp;
+				if(polyMeshDetail)
+				{
+					params.detailMeshes = polyMeshDetail->meshes;
+					params.detailVerts = polyMeshDetail->verts;
+					params.detailVertsCount = polyMeshDetail->nverts;
+					params.detailTris = polyMeshDetail->tris;
+					params.detailTriCount = polyMeshDetail->ntris;
+				}
 /*				params.offMeshConVerts = m_geom->getOffMeshConnectionVerts();
 				params.offMeshConRad = m_geom->getOffMeshConnectionRads();
 				params.offMeshConDir = m_geom->getOffMeshConnectionDirs();
@@ -463,8 +544,8 @@ namespace RN
 				params.walkableHeight = _agentHeight;
 				params.walkableRadius = _agentRadius;
 				params.walkableClimb = _agentMaxClimb;
-				rcVcopy(params.bmin, _polyMesh->bmin);
-				rcVcopy(params.bmax, _polyMesh->bmax);
+				rcVcopy(params.bmin, polyMesh->bmin);
+				rcVcopy(params.bmax, polyMesh->bmax);
 				params.cs = _recastConfig.cs;
 				params.ch = _recastConfig.ch;
 				params.buildBvTree = true;
@@ -475,52 +556,754 @@ namespace RN
 					return false;
 				}
 				
-				_navigationMesh = dtAllocNavMesh();
-				if(!_navigationMesh)
+				dtNavMesh *navigationMesh = dtAllocNavMesh();
+				if(!navigationMesh)
 				{
 					dtFree(navData);
 					buildContext->log(RC_LOG_ERROR, "Could not create Detour navmesh");
 					return false;
 				}
 				
+				// Init as tiled mesh, so tiles can be added and replaced later on.
+				// Reference bits are split between the polygons per tile and the tile count.
+				int polyBits = dtIlog2(dtNextPow2(static_cast<unsigned int>(rcMax(polyMesh->npolys, _maxTilePolygons))));
+				int tileBits = rcMin(static_cast<int>(dtIlog2(dtNextPow2(static_cast<unsigned int>(rcMax(_maxTiles, 1))))), rcMax(22 - polyBits, 0));
+				
+				dtNavMeshParams navigationParams;
+				memset(&navigationParams, 0, sizeof(navigationParams));
+				rcVcopy(navigationParams.orig, polyMesh->bmin);
+				navigationParams.tileWidth = polyMesh->bmax[0] - polyMesh->bmin[0];
+				navigationParams.tileHeight = polyMesh->bmax[2] - polyMesh->bmin[2];
+				navigationParams.maxTiles = 1 << tileBits;
+				navigationParams.maxPolys = 1 << polyBits;
+				
 				dtStatus status;
 				
-				status = _navigationMesh->init(navData, navDataSize, DT_TILE_FREE_DATA);
+				status = navigationMesh->init(&navigationParams);
 				if(dtStatusFailed(status))
 				{
 					dtFree(navData);
+					dtFreeNavMesh(navigationMesh);
 					buildContext->log(RC_LOG_ERROR, "Could not init Detour navmesh");
 					return false;
 				}
+				
+				std::lock_guard<std::mutex> lock(_tileLock);
+				
+				// References into a previous build must not resolve to polygons of this one
+				status = navigationMesh->addTile(navData, navDataSize, DT_TILE_FREE_DATA, NextTileRef(navigationMesh, 0), nullptr);
+				if(dtStatusFailed(status))
+				{
+					dtFree(navData);
+					dtFreeNavMesh(navigationMesh);
+					buildContext->log(RC_LOG_ERROR, "Could not add Detour navmesh tile");
+					return false;
+				}
+				
+				PublishNavigationMesh(navigationMesh);
 			}
 			
 			buildContext->stopTimer(RC_TIMER_TOTAL);
 			
 			// Show performance stats.
-			buildContext->log(RC_LOG_PROGRESS, ">> Polymesh: %d vertices  %d polygons", _polyMesh->nverts, _polyMesh->npolys);
+			buildContext->log(RC_LOG_PROGRESS, ">> Polymesh: %d vertices  %d polygons", polyMesh->nverts, polyMesh->npolys);
+			buildContext->log(RC_LOG_PROGRESS, ">> Build arena: %.1f MB peak", arenaScope.GetArena()->GetPeakSize() / (1024.0f * 1024.0f));
 			
-			delete buildContext;
+			// Queries only need the Detour tiles. Only a complete build replaces the intermediates,
+			// GetMemoryReport() and DumpToOBJ() never see one that is still being filled in.
+			if(!_compact)
+			{
+				std::lock_guard<std::mutex> lock(_tileLock);
+				_polyMesh = polyMesh.release();
+				_polyMeshDetail = polyMeshDetail.release();
+			}
 			
 			return true;
 		}
 		
+		float Heightmap::GetHeight(float x, float z) const
+		{
+			float sampleX = rcClamp((x - origin.x) / spacing, 0.0f, static_cast<float>(width - 1));
+			float sampleZ = rcClamp((z - origin.z) / spacing, 0.0f, static_cast<float>(depth - 1));
+			
+			size_t x0 = rcMin(static_cast<size_t>(sampleX), width - 2);
+			size_t z0 = rcMin(static_cast<size_t>(sampleZ), depth - 2);
+			float fractionX = sampleX - x0;
+			float fractionZ = sampleZ - z0;
+			
+			const float *row0 = heights + z0 * width + x0;
+			const float *row1 = row0 + width;
+			
+			float height0 = row0[0] + (row0[1] - row0[0]) * fractionX;
+			float height1 = row1[0] + (row1[1] - row1[0]) * fractionX;
+			
+			return origin.y + height0 + (height1 - height0) * fractionZ;
+		}
+		
+		void Heightmap::GetBounds(float *bmin, float *bmax) const
+		{
+			float minHeight = heights[0];
+			float maxHeight = heights[0];
+			
+			for(size_t i = 1; i < width * depth; i++)
+			{
+				minHeight = rcMin(minHeight, heights[i]);
+				maxHeight = rcMax(maxHeight, heights[i]);
+			}
+			
+			bmin[0] = origin.x;
+			bmin[1] = origin.y + minHeight;
+			bmin[2] = origin.z;
+			bmax[0] = origin.x + (width - 1) * spacing;
+			bmax[1] = origin.y + maxHeight;
+			bmax[2] = origin.z + (depth - 1) * spacing;
+		}
+		
+		void Mesh::RasterizeHeightmap(BuildContext *buildContext, const Heightmap &heightmap, rcHeightfield &heightfield)
+		{
+			buildContext->startTimer(RC_TIMER_RASTERIZE_TRIANGLES);
+			
+			// Same slope test as rcMarkWalkableTriangles, on the surface normal (-dh/dx, 1, -dh/dz)
+			const float walkableThreshold = cosf(_recastConfig.walkableSlopeAngle / 180.0f * RC_PI);
+			
+			const float heightmapMaxX = heightmap.origin.x + (heightmap.width - 1) * heightmap.spacing;
+			const float heightmapMaxZ = heightmap.origin.z + (heightmap.depth - 1) * heightmap.spacing;
+			
+			for(int z = 0; z < heightfield.height; z++)
+			{
+				const float cellMinZ = heightfield.bmin[2] + z * heightfield.cs;
+				const float cellMaxZ = cellMinZ + heightfield.cs;
+				
+				if(cellMaxZ <= heightmap.origin.z || cellMinZ >= heightmapMaxZ)
+					continue;
+				
+				for(int x = 0; x < heightfield.width; x++)
+				{
+					const float cellMinX = heightfield.bmin[0] + x * heightfield.cs;
+					const float cellMaxX = cellMinX + heightfield.cs;
+					
+					if(cellMaxX <= heightmap.origin.x || cellMinX >= heightmapMaxX)
+						continue;
+					
+					// The surface is bilinear between samples, so its extremes within the
+					// cell are at the cell corners or at samples inside of the cell.
+					float corners[4];
+					corners[0] = heightmap.GetHeight(cellMinX, cellMinZ);
+					corners[1] = heightmap.GetHeight(cellMaxX, cellMinZ);
+					corners[2] = heightmap.GetHeight(cellMinX, cellMaxZ);
+					corners[3] = heightmap.GetHeight(cellMaxX, cellMaxZ);
+					
+					float minHeight = rcMin(rcMin(corners[0], corners[1]), rcMin(corners[2], corners[3]));
+					float maxHeight = rcMax(rcMax(corners[0], corners[1]), rcMax(corners[2], corners[3]));
+					
+					int firstSampleX = rcMax(static_cast<int>(ceilf((cellMinX - heightmap.origin.x) / heightmap.spacing)), 0);
+					int lastSampleX = rcMin(static_cast<int>(floorf((cellMaxX - heightmap.origin.x) / heightmap.spacing)), static_cast<int>(heightmap.width) - 1);
+					int firstSampleZ = rcMax(static_cast<int>(ceilf((cellMinZ - heightmap.origin.z) / heightmap.spacing)), 0);
+					int lastSampleZ = rcMin(static_cast<int>(floorf((cellMaxZ - heightmap.origin.z) / heightmap.spacing)), static_cast<int>(heightmap.depth) - 1);
+					
+					for(int sampleZ = firstSampleZ; sampleZ <= lastSampleZ; sampleZ++)
+					{
+						for(int sampleX = firstSampleX; sampleX <= lastSampleX; sampleX++)
+						{
+							float height = heightmap.origin.y + heightmap.heights[sampleZ * heightmap.width + sampleX];
+							minHeight = rcMin(minHeight, height);
+							maxHeight = rcMax(maxHeight, height);
+						}
+					}
+					
+					float slopeX = ((corners[1] + corners[3]) - (corners[0] + corners[2])) * 0.5f / heightfield.cs;
+					float slopeZ = ((corners[2] + corners[3]) - (corners[0] + corners[1])) * 0.5f / heightfield.cs;
+					float normalY = 1.0f / sqrtf(1.0f + slopeX * slopeX + slopeZ * slopeZ);
+					
+					unsigned char area = (normalY > walkableThreshold) ? RC_WALKABLE_AREA : RC_NULL_AREA;
+					
+					int spanMin = static_cast<int>(floorf((minHeight - heightfield.bmin[1]) / heightfield.ch));
+					int spanMax = static_cast<int>(ceilf((maxHeight - heightfield.bmin[1]) / heightfield.ch));
+					
+					spanMin = rcClamp(spanMin, 0, RC_SPAN_MAX_HEIGHT);
+					spanMax = rcClamp(spanMax, spanMin + 1, RC_SPAN_MAX_HEIGHT);
+					
+					rcAddSpan(buildContext, heightfield, x, z, static_cast<unsigned short>(spanMin), static_cast<unsigned short>(spanMax), area, _recastConfig.walkableClimb);
+				}
+			}
+			
+			buildContext->stopTimer(RC_TIMER_RASTERIZE_TRIANGLES);
+		}
+		
 		void Mesh::Cleanup()
 		{
+			CleanupIntermediates();
+			
+			std::lock_guard<std::mutex> lock(_tileLock);
+			PublishNavigationMesh(nullptr);
+		}
+		
+		void Mesh::CleanupIntermediates()
+		{
+			std::lock_guard<std::mutex> lock(_tileLock);
+			
 			rcFreePolyMesh(_polyMesh);
 			_polyMesh = 0;
 			rcFreePolyMeshDetail(_polyMeshDetail);
 			_polyMeshDetail = 0;
-			dtFreeNavMesh(_navigationMesh);
-			_navigationMesh = 0;
+		}
+		
+		static uint64 HashNavigationMesh(const dtNavMesh *navigationMesh)
+		{
+			// FNV-1a over the parts of the tiles that do not change when linking them
+			uint64 hash = 14695981039346656037ULL;
+			auto combine = [&](const void *data, size_t size) {
+				const uint8 *bytes = static_cast<const uint8 *>(data);
+				for(size_t i = 0; i < size; i++)
+				{
+					hash ^= bytes[i];
+					hash *= 1099511628211ULL;
+				}
+			};
+			
+			if(!navigationMesh)
+				return 0;
+			
+			for(int i = 0; i < navigationMesh->getMaxTiles(); i++)
+			{
+				const dtMeshTile *tile = navigationMesh->getTile(i);
+				if(!tile || !tile->header)
+					continue;
+				
+				combine(tile->header, sizeof(dtMeshHeader));
+				combine(tile->verts, sizeof(float) * 3 * tile->header->vertCount);
+				combine(tile->detailVerts, sizeof(float) * 3 * tile->header->detailVertCount);
+			}
+			
+			return hash;
+		}
+		
+		void Mesh::PublishNavigationMesh(dtNavMesh *navigationMesh, std::shared_ptr<const LandmarkTable> landmarks)
+		{
+			uint64 versionHash = HashNavigationMesh(navigationMesh);
+			
+			// Odd while the mesh and its hash don't match, see GetDetourNavigationMesh(uint64 &)
+			_publishSequence.fetch_add(1);
+			
+			// Paths check the table against the mesh they got, so the order of these doesn't matter
+			_versionHash.store(versionHash);
+			std::atomic_store(&_landmarks, landmarks);
+			
+			for(int i = 0; navigationMesh && i < navigationMesh->getMaxTiles(); i++)
+			{
+				const dtMeshTile *tile = navigationMesh->getTile(i);
+				if(!tile || !tile->header)
+					continue;
+				
+				if(_tileSalts.size() <= static_cast<size_t>(i))
+					_tileSalts.resize(i + 1, 0);
+				
+				_tileSalts[i] = std::max(_tileSalts[i], static_cast<uint32>(tile->salt));
+			}
+			
+			dtNavMesh *previous = _navigationMesh.exchange(navigationMesh);
+			_publishSequence.fetch_add(1);
+			
+			if(previous)
+			{
+				_epochDomain.Retire([previous]() {
+					dtFreeNavMesh(previous);
+				});
+			}
+			
+			_epochDomain.Reclaim();
+		}
+		
+		dtTileRef Mesh::NextTileRef(const dtNavMesh *navigationMesh, int slot)
+		{
+			// Every freshly initialised mesh starts all slots at salt 1, so the salts are tracked here
+			// and bumped whenever a slot gets a new tile, the same way dtNavMesh::removeTile does.
+			const dtNavMeshParams *params = navigationMesh->getParams();
+			int tileBits = dtIlog2(dtNextPow2(static_cast<unsigned int>(params->maxTiles)));
+			int polyBits = dtIlog2(dtNextPow2(static_cast<unsigned int>(params->maxPolys)));
+			uint32 saltMask = (1U << dtMin(31, 32 - tileBits - polyBits)) - 1;
+			
+			if(_tileSalts.size() <= static_cast<size_t>(slot))
+				_tileSalts.resize(slot + 1, 0);
+			
+			uint32 salt = (_tileSalts[slot] + 1) & saltMask;
+			if(salt == 0)
+				salt = 1;
+			
+			_tileSalts[slot] = salt;
+			return navigationMesh->encodePolyId(salt, slot, 0);
+		}
+		
+		dtNavMesh *Mesh::CopyNavigationMesh(int32 skipX, int32 skipY, int32 skipLayer)
+		{
+			const dtNavMesh *navigationMesh = _navigationMesh.load();
+			if(!navigationMesh)
+				return nullptr;
+			
+			dtNavMesh *copy = dtAllocNavMesh();
+			if(!copy)
+				return nullptr;
+			
+			if(dtStatusFailed(copy->init(navigationMesh->getParams())))
+			{
+				dtFreeNavMesh(copy);
+				return nullptr;
+			}
+			
+			// Tile data only holds the serialized tile and gets relinked on add,
+			// passing the old tile reference keeps all polygon references stable.
+			for(int i = 0; i < navigationMesh->getMaxTiles(); i++)
+			{
+				const dtMeshTile *tile = navigationMesh->getTile(i);
+				if(!tile || !tile->header || !tile->dataSize)
+					continue;
+				
+				if(tile->header->x == skipX && tile->header->y == skipY && tile->header->layer == skipLayer)
+					continue;
+				
+				unsigned char *data = static_cast<unsigned char *>(dtAlloc(tile->dataSize, DT_ALLOC_PERM));
+				if(!data)
+				{
+					dtFreeNavMesh(copy);
+					return nullptr;
+				}
+				
+				memcpy(data, tile->data, tile->dataSize);
+				
+				if(dtStatusFailed(copy->addTile(data, tile->dataSize, DT_TILE_FREE_DATA, navigationMesh->getTileRef(tile), nullptr)))
+				{
+					dtFree(data);
+					dtFreeNavMesh(copy);
+					return nullptr;
+				}
+			}
+			
+			return copy;
+		}
+		
+		bool Mesh::AddTile(const uint8 *data, size_t size)
+		{
+			RN_ASSERT(data && size >= sizeof(dtMeshHeader), "Tile data must contain at least a header.");
+			
+			const dtMeshHeader *header = reinterpret_cast<const dtMeshHeader *>(data);
+			if(header->magic != DT_NAVMESH_MAGIC || header->version != DT_NAVMESH_VERSION)
+				return false;
+			
+			std::lock_guard<std::mutex> lock(_tileLock);
+			
+			// Polygon indices past maxPolys would spill into the tile bits of their references
+			const dtNavMesh *current = _navigationMesh.load();
+			if(!current || header->polyCount > current->getParams()->maxPolys)
+				return false;
+			
+			dtNavMesh *navigationMesh = CopyNavigationMesh(header->x, header->y, header->layer);
+			if(!navigationMesh)
+				return false;
+			
+			unsigned char *tileData = static_cast<unsigned char *>(dtAlloc(static_cast<int>(size), DT_ALLOC_PERM));
+			if(!tileData)
+			{
+				dtFreeNavMesh(navigationMesh);
+				return false;
+			}
+			
+			memcpy(tileData, data, size);
+			
+			// A replaced tile keeps its slot, a new one takes the first free slot. Either way the slot's
+			// salt is bumped, so references to a previous tile in that slot no longer resolve.
+			int slot = -1;
+			
+			const dtMeshTile *replaced = current->getTileAt(header->x, header->y, header->layer);
+			
+			if(replaced)
+			{
+				slot = static_cast<int>(current->decodePolyIdTile(current->getTileRef(replaced)));
+			}
+			else
+			{
+				for(int i = 0; i < navigationMesh->getMaxTiles() && slot == -1; i++)
+				{
+					const dtMeshTile *tile = navigationMesh->getTile(i);
+					if(tile && !tile->header)
+						slot = i;
+				}
+			}
+			
+			if(slot == -1 || dtStatusFailed(navigationMesh->addTile(tileData, static_cast<int>(size), DT_TILE_FREE_DATA, NextTileRef(navigationMesh, slot), nullptr)))
+			{
+				dtFree(tileData);
+				dtFreeNavMesh(navigationMesh);
+				return false;
+			}
+			
+			PublishNavigationMesh(navigationMesh);
+			return true;
+		}
+		
+		bool Mesh::RemoveTile(int32 x, int32 y, int32 layer)
+		{
+			std::lock_guard<std::mutex> lock(_tileLock);
+			
+			dtNavMesh *current = _navigationMesh.load();
+			if(!current || !current->getTileAt(x, y, layer))
+				return false;
+			
+			dtNavMesh *navigationMesh = CopyNavigationMesh(x, y, layer);
+			if(!navigationMesh)
+				return false;
+			
+			PublishNavigationMesh(navigationMesh);
+			return true;
 		}
 		
 		dtNavMesh *Mesh::GetDetourNavigationMesh()
 		{
-			return _navigationMesh;
+			return _navigationMesh.load();
+		}
+		
+		dtNavMesh *Mesh::GetDetourNavigationMesh(uint64 &versionHash)
+		{
+			// Publishing is two stores, retry until both loads happened between the same pair of sequence bumps
+			while(true)
+			{
+				uint32 sequence = _publishSequence.load();
+				if(sequence & 1)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				
+				dtNavMesh *navigationMesh = _navigationMesh.load();
+				versionHash = _versionHash.load();
+				
+				if(_publishSequence.load() == sequence)
+					return navigationMesh;
+			}
+		}
+		
+		void Mesh::SetQueryCapture(QueryCapture *capture)
+		{
+			if(capture)
+				capture->Retain();
+			
+			QueryCapture *previous = _queryCapture.exchange(capture);
+			if(previous)
+			{
+				// Queries may still be recording into it
+				_epochDomain.Retire([previous]() {
+					previous->Release();
+				});
+				_epochDomain.Reclaim();
+			}
+		}
+		
+		bool Mesh::BuildLandmarks(size_t count)
+		{
+			std::lock_guard<std::mutex> lock(_tileLock);
+			
+			const dtNavMesh *navigationMesh = _navigationMesh.load();
+			if(!navigationMesh)
+				return false;
+			
+			std::shared_ptr<const LandmarkTable> landmarks = LandmarkTable::Build(navigationMesh, _versionHash.load(), count);
+			std::atomic_store(&_landmarks, landmarks);
+			
+			return true;
+		}
+		
+		Mesh::MemoryReport::MemoryReport() :
+		tileBytes(0), intermediateBytes(0), landmarkBytes(0)
+		{}
+		
+		Mesh::MemoryReport Mesh::GetMemoryReport()
+		{
+			// The tile lock keeps the current mesh alive and the intermediates from being swapped or freed by a build
+			std::lock_guard<std::mutex> lock(_tileLock);
+			
+			MemoryReport report;
+			
+			const dtNavMesh *navigationMesh = _navigationMesh.load();
+			for(int i = 0; navigationMesh && i < navigationMesh->getMaxTiles(); i++)
+			{
+				const dtMeshTile *tile = navigationMesh->getTile(i);
+				if(!tile || !tile->header)
+					continue;
+				
+				const dtMeshHeader *header = tile->header;
+				
+				TileMemory memory;
+				memory.x = header->x;
+				memory.y = header->y;
+				memory.layer = header->layer;
+				memory.polygons = header->polyCount;
+				memory.vertices = header->vertCount;
+				memory.detailVertices = header->detailVertCount;
+				memory.detailTriangles = header->detailTriCount;
+				memory.polygonBytes = sizeof(dtPoly) * header->polyCount;
+				memory.vertexBytes = sizeof(float) * 3 * header->vertCount;
+				memory.linkBytes = sizeof(dtLink) * header->maxLinkCount;
+				memory.detailBytes = sizeof(dtPolyDetail) * header->detailMeshCount + sizeof(float) * 3 * header->detailVertCount + 4 * header->detailTriCount;
+				memory.bvTreeBytes = sizeof(dtBVNode) * header->bvNodeCount;
+				memory.totalBytes = tile->dataSize;
+				
+				report.tileBytes += memory.totalBytes;
+				report.tiles.push_back(memory);
+			}
+			
+			if(_polyMesh)
+			{
+				size_t polygonSize = sizeof(unsigned short) * _polyMesh->nvp * 2 + sizeof(unsigned short) * 2 + sizeof(unsigned char);
+				report.intermediateBytes += sizeof(unsigned short) * 3 * _polyMesh->nverts + polygonSize * _polyMesh->maxpolys;
+			}
+			
+			if(_polyMeshDetail)
+				report.intermediateBytes += sizeof(unsigned int) * 4 * _polyMeshDetail->nmeshes + sizeof(float) * 3 * _polyMeshDetail->nverts + 4 * _polyMeshDetail->ntris;
+			
+			std::shared_ptr<const LandmarkTable> landmarks = GetLandmarks();
+			if(landmarks)
+				report.landmarkBytes = landmarks->GetMemorySize();
+			
+			return report;
+		}
+		
+		
+		// Same layout as the tile mesh set used by the Recast demo
+		static const int32 NavigationMeshSetMagic = 'M'<<24 | 'S'<<16 | 'E'<<8 | 'T';
+		static const int32 NavigationMeshSetVersion = 1;
+		static const int32 NavigationMeshSetQuantizedVersion = 2;
+		
+		struct NavigationMeshSetHeader
+		{
+			int32 magic;
+			int32 version;
+			int32 numTiles;
+			dtNavMeshParams params;
+		};
+		
+		struct NavigationMeshTileHeader
+		{
+			dtTileRef tileRef;
+			int32 dataSize;
+		};
+		
+		// Follows the tile header in quantized sets, a vertex count of 0 means the tile data is stored as is.
+		// Otherwise the vertex array is replaced by 16 bit offsets from the tile minimum in cells.
+		struct QuantizedTileHeader
+		{
+			int32 vertexOffset;
+			int32 vertexCount;
+			float cellSize;
+			float cellHeight;
+		};
+		
+		static bool QuantizeVertices(const dtMeshTile *tile, const float *steps, std::vector<uint16> &quantized)
+		{
+			const float *bmin = tile->header->bmin;
+			
+			quantized.resize(tile->header->vertCount * 3);
+			
+			for(size_t i = 0; i < quantized.size(); i++)
+			{
+				float offset = (tile->verts[i] - bmin[i % 3]) / steps[i % 3];
+				if(offset < 0.0f || offset > 65535.0f)
+					return false;
+				
+				// Same expression dtCreateNavMeshData uses, only quantize if the vertex comes back bit exact
+				uint16 value = static_cast<uint16>(offset + 0.5f);
+				if(bmin[i % 3] + value * steps[i % 3] != tile->verts[i])
+					return false;
+				
+				quantized[i] = value;
+			}
+			
+			return true;
+		}
+		
+		static bool WriteQuantizedTile(FILE *file, const dtMeshTile *tile, float cellSize, float cellHeight)
+		{
+			const float steps[3] = { cellSize, cellHeight, cellSize };
+			std::vector<uint16> quantized;
+			
+			QuantizedTileHeader header;
+			header.vertexOffset = static_cast<int32>(reinterpret_cast<const uint8 *>(tile->verts) - tile->data);
+			header.vertexCount = QuantizeVertices(tile, steps, quantized) ? tile->header->vertCount : 0;
+			header.cellSize = cellSize;
+			header.cellHeight = cellHeight;
+			
+			if(fwrite(&header, sizeof(header), 1, file) != 1)
+				return false;
+			
+			if(header.vertexCount == 0)
+				return (fwrite(tile->data, tile->dataSize, 1, file) == 1);
+			
+			size_t vertexEnd = header.vertexOffset + sizeof(float) * 3 * header.vertexCount;
+			
+			bool success = (fwrite(tile->data, header.vertexOffset, 1, file) == 1);
+			success = success && (fwrite(quantized.data(), sizeof(uint16), quantized.size(), file) == quantized.size());
+			success = success && (vertexEnd == static_cast<size_t>(tile->dataSize) || fwrite(tile->data + vertexEnd, tile->dataSize - vertexEnd, 1, file) == 1);
+			
+			return success;
+		}
+		
+		static bool ReadQuantizedTile(FILE *file, uint8 *data, int32 dataSize)
+		{
+			QuantizedTileHeader header;
+			if(fread(&header, sizeof(header), 1, file) != 1)
+				return false;
+			
+			if(header.vertexCount == 0)
+				return (fread(data, dataSize, 1, file) == 1);
+			
+			size_t vertexEnd = header.vertexOffset + sizeof(float) * 3 * header.vertexCount;
+			if(header.vertexOffset < static_cast<int32>(sizeof(dtMeshHeader)) || header.vertexCount < 0 || vertexEnd > static_cast<size_t>(dataSize))
+				return false;
+			
+			std::vector<uint16> quantized(header.vertexCount * 3);
+			
+			bool success = (fread(data, header.vertexOffset, 1, file) == 1);
+			success = success && (fread(quantized.data(), sizeof(uint16), quantized.size(), file) == quantized.size());
+			success = success && (vertexEnd == static_cast<size_t>(dataSize) || fread(data + vertexEnd, dataSize - vertexEnd, 1, file) == 1);
+			
+			if(!success)
+				return false;
+			
+			const dtMeshHeader *tileHeader = reinterpret_cast<const dtMeshHeader *>(data);
+			const float steps[3] = { header.cellSize, header.cellHeight, header.cellSize };
+			
+			float *vertices = reinterpret_cast<float *>(data + header.vertexOffset);
+			for(size_t i = 0; i < quantized.size(); i++)
+				vertices[i] = tileHeader->bmin[i % 3] + quantized[i] * steps[i % 3];
+			
+			return true;
+		}
+		
+		bool Mesh::WriteToFile(const char *path)
+		{
+			// Holding the tile lock keeps the current mesh from being retired
+			std::lock_guard<std::mutex> lock(_tileLock);
+			
+			const dtNavMesh *navigationMesh = _navigationMesh.load();
+			if(!navigationMesh)
+				return false;
+			
+			FILE *file = fopen(path, "wb");
+			if(!file)
+				return false;
+			
+			NavigationMeshSetHeader header;
+			header.magic = NavigationMeshSetMagic;
+			header.version = _compact ? NavigationMeshSetQuantizedVersion : NavigationMeshSetVersion;
+			header.numTiles = 0;
+			memcpy(&header.params, navigationMesh->getParams(), sizeof(dtNavMeshParams));
+			
+			for(int i = 0; i < navigationMesh->getMaxTiles(); i++)
+			{
+				const dtMeshTile *tile = navigationMesh->getTile(i);
+				if(tile && tile->header && tile->dataSize)
+					header.numTiles ++;
+			}
+			
+			bool success = (fwrite(&header, sizeof(header), 1, file) == 1);
+			
+			for(int i = 0; i < navigationMesh->getMaxTiles() && success; i++)
+			{
+				const dtMeshTile *tile = navigationMesh->getTile(i);
+				if(!tile || !tile->header || !tile->dataSize)
+					continue;
+				
+				NavigationMeshTileHeader tileHeader;
+				tileHeader.tileRef = navigationMesh->getTileRef(tile);
+				tileHeader.dataSize = tile->dataSize;
+				
+				success = (fwrite(&tileHeader, sizeof(tileHeader), 1, file) == 1);
+				
+				if(_compact)
+					success = success && WriteQuantizedTile(file, tile, _cellSize, _cellHeight);
+				else
+					success = success && (fwrite(tile->data, tile->dataSize, 1, file) == 1);
+			}
+			
+			// Optional trailing section, older readers stop after the tiles
+			std::shared_ptr<const LandmarkTable> landmarks = GetLandmarks();
+			if(success && landmarks && landmarks->IsValidFor(navigationMesh, _versionHash.load()))
+				success = landmarks->Write(file);
+			
+			fclose(file);
+			return success;
+		}
+		
+		bool Mesh::ReadFromFile(const char *path)
+		{
+			FILE *file = fopen(path, "rb");
+			if(!file)
+				return false;
+			
+			NavigationMeshSetHeader header;
+			if(fread(&header, sizeof(header), 1, file) != 1 || header.magic != NavigationMeshSetMagic || (header.version != NavigationMeshSetVersion && header.version != NavigationMeshSetQuantizedVersion))
+			{
+				fclose(file);
+				return false;
+			}
+			
+			dtNavMesh *navigationMesh = dtAllocNavMesh();
+			if(!navigationMesh || dtStatusFailed(navigationMesh->init(&header.params)))
+			{
+				dtFreeNavMesh(navigationMesh);
+				fclose(file);
+				return false;
+			}
+			
+			for(int32 i = 0; i < header.numTiles; i++)
+			{
+				NavigationMeshTileHeader tileHeader;
+				if(fread(&tileHeader, sizeof(tileHeader), 1, file) != 1 || tileHeader.dataSize <= 0)
+				{
+					dtFreeNavMesh(navigationMesh);
+					fclose(file);
+					return false;
+				}
+				
+				unsigned char *data = static_cast<unsigned char *>(dtAlloc(tileHeader.dataSize, DT_ALLOC_PERM));
+				bool quantized = (header.version == NavigationMeshSetQuantizedVersion);
+				bool loaded = data && (quantized ? ReadQuantizedTile(file, data, tileHeader.dataSize) : fread(data, tileHeader.dataSize, 1, file) == 1);
+				
+				if(!loaded || dtStatusFailed(navigationMesh->addTile(data, tileHeader.dataSize, DT_TILE_FREE_DATA, tileHeader.tileRef, nullptr)))
+				{
+					dtFree(data);
+					dtFreeNavMesh(navigationMesh);
+					fclose(file);
+					return false;
+				}
+			}
+			
+			std::shared_ptr<const LandmarkTable> landmarks;
+			
+			int next = fgetc(file);
+			if(next != EOF)
+			{
+				ungetc(next, file);
+				
+				// A broken table only costs the faster search, the tiles are still usable
+				landmarks = LandmarkTable::Read(file, navigationMesh, HashNavigationMesh(navigationMesh));
+			}
+			
+			fclose(file);
+			
+			CleanupIntermediates();
+			
+			std::lock_guard<std::mutex> lock(_tileLock);
+			PublishNavigationMesh(navigationMesh, landmarks);
+			
+			return true;
 		}
 		
 		void Mesh::DumpToOBJ(const char *path)
 		{
+			std::lock_guard<std::mutex> lock(_tileLock);
+			
+			if(!_polyMeshDetail)
+				return;
+			
 			FileIO io(path);
 			duDumpPolyMeshDetailToObj(*_polyMeshDetail, &io);
 		}
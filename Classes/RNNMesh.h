@@ -20,11 +20,22 @@
 
 #include <Rayne/Rayne.h>
 
+#include <memory>
+#include <thread>
+
+#include "RNNDetourConfig.h"
+
 #include "Recast.h"
+#include "DetourCommon.h"
 #include "DetourNavMesh.h"
 #include "DetourNavMeshBuilder.h"
 #include "RecastDump.h"
 
+#include "RNNBuildArena.h"
+#include "RNNEpoch.h"
+#include "RNNLandmarks.h"
+#include "RNNStatistics.h"
+
 namespace RN
 {
 	namespace navigation
@@ -59,6 +70,26 @@ namespace RN
 			FILE *_file;
 		};
 		
+		class QueryCapture;
+		
+		/// Regular grid of terrain heights, sample (x, z) is at origin + (x * spacing, heights[z * width + x], z * spacing).
+		/// The heights are not copied and only need to stay valid while generating.
+		struct Heightmap
+		{
+			Heightmap() :
+			origin(0.0f), spacing(1.0f), width(0), depth(0), heights(nullptr)
+			{}
+			
+			float GetHeight(float x, float z) const;
+			void GetBounds(float *bmin, float *bmax) const;
+			
+			RN::Vector3 origin;
+			float spacing;
+			size_t width;
+			size_t depth;
+			const float *heights;
+		};
+		
 		class Mesh : public RN::Object
 		{
 		public:
@@ -69,6 +100,45 @@ namespace RN
 				Layers,
 			};
 			
+			/// Height detail kept in the Detour tiles. Without it heights come from the polygon vertices,
+			/// which is enough for agents that snap to the ground themselves.
+			enum DetailMode
+			{
+				FullDetail,
+				SimplifiedDetail,
+				NoDetail
+			};
+			
+			struct TileMemory
+			{
+				int32 x;
+				int32 y;
+				int32 layer;
+				
+				size_t polygons;
+				size_t vertices;
+				size_t detailVertices;
+				size_t detailTriangles;
+				
+				size_t polygonBytes;
+				size_t vertexBytes;
+				size_t linkBytes;
+				size_t detailBytes;
+				size_t bvTreeBytes;
+				size_t totalBytes;
+			};
+			
+			/// Sizes in bytes of everything the mesh keeps resident.
+			struct MemoryReport
+			{
+				MemoryReport();
+				
+				std::vector<TileMemory> tiles;
+				size_t tileBytes;
+				size_t intermediateBytes;
+				size_t landmarkBytes;
+			};
+			
 			Mesh();
 			Mesh(RN::Model *model);
 			~Mesh();
@@ -76,7 +146,39 @@ namespace RN
 			bool GenerateFromModel(RN::Model *model);
 			bool GenerateFromModels(RN::Array *models);
 			
+			/// Builds from terrain without triangulating it, the models are optional props placed on it.
+			bool GenerateFromHeightmap(const Heightmap &heightmap, RN::Array *models = nullptr);
+			
+			/// Adds the tile, replacing a tile already at the same location. The data is copied.
+			bool AddTile(const uint8 *data, size_t size);
+			bool RemoveTile(int32 x, int32 y, int32 layer);
+			
+			/// Returns the currently published navigation mesh. Concurrent readers must
+			/// only use it inside an EpochDomain::ReadGuard of GetEpochDomain().
 			dtNavMesh *GetDetourNavigationMesh();
+			/// Same as above, with the version hash of exactly the returned mesh.
+			dtNavMesh *GetDetourNavigationMesh(uint64 &versionHash);
+			EpochDomain *GetEpochDomain() { return &_epochDomain; }
+			QueryStatistics *GetQueryStatistics() { return &_queryStatistics; }
+			
+			/// Hash over the static tile data, changes whenever tiles are added, removed or regenerated.
+			uint64 GetVersionHash() const { return _versionHash.load(); }
+			
+			/// Captures all path queries run on this mesh while set, pass nullptr to stop capturing.
+			void SetQueryCapture(QueryCapture *capture);
+			QueryCapture *GetQueryCapture() { return _queryCapture.load(); }
+			
+			/// Precomputes the distance table used by Path::useLandmarks, it is stored with WriteToFile().
+			/// Adding or removing tiles invalidates it, paths fall back to Detour until it is built again.
+			bool BuildLandmarks(size_t count = 8);
+			std::shared_ptr<const LandmarkTable> GetLandmarks() const { return std::atomic_load(&_landmarks); }
+			
+			MemoryReport GetMemoryReport();
+			
+			/// Writes the baked Detour tiles, ReadFromFile() replaces the current navigation mesh with them.
+			/// Compact meshes store their tile vertices as 16 bit cell coordinates where that is lossless.
+			bool WriteToFile(const char *path);
+			bool ReadFromFile(const char *path);
 			
 			void DumpToOBJ(const char *path);
 			
@@ -93,10 +195,25 @@ namespace RN
 			float _vertsPerPoly;
 			float _detailSampleDist;
 			float _detailSampleMaxError;
+			int32 _maxTiles;
+			/// Polygons per tile reserved in polygon references, AddTile() rejects larger tiles.
+			/// The generated tile's polygon count is used if it is larger.
+			int32 _maxTilePolygons;
+			/// Frees the Recast poly meshes once the Detour tiles are built, DumpToOBJ() does nothing afterwards.
+			bool _compact;
+			DetailMode _detailMode;
 			
 		private:
 			void Initialize();
 			void Cleanup();
+			void CleanupIntermediates();
+			
+			bool Generate(RN::Array *models, const Heightmap *heightmap);
+			void RasterizeHeightmap(BuildContext *buildContext, const Heightmap &heightmap, rcHeightfield &heightfield);
+			
+			dtTileRef NextTileRef(const dtNavMesh *navigationMesh, int slot);
+			dtNavMesh *CopyNavigationMesh(int32 skipX, int32 skipY, int32 skipLayer);
+			void PublishNavigationMesh(dtNavMesh *navigationMesh, std::shared_ptr<const LandmarkTable> landmarks = nullptr);
 			
 			PartitionType _partitionType;
 			
@@ -104,7 +221,15 @@ namespace RN
 			rcConfig _recastConfig;
 			rcPolyMeshDetail* _polyMeshDetail;
 			
-			dtNavMesh* _navigationMesh;
+			std::atomic<dtNavMesh *> _navigationMesh;
+			std::atomic<uint64> _versionHash;
+			std::atomic<uint32> _publishSequence;
+			std::atomic<QueryCapture *> _queryCapture;
+			std::shared_ptr<const LandmarkTable> _landmarks;
+			std::mutex _tileLock;
+			std::vector<uint32> _tileSalts;
+			EpochDomain _epochDomain;
+			QueryStatistics _queryStatistics;
 			
 			/*status = _navigationQuery->init(_navigationMesh, 2048);
 			dtNavMeshQuery *_navigationQuery;*/
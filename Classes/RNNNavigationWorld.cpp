@@ -21,21 +21,249 @@ namespace RN
 {
 	namespace navigation
 	{
-		RNDefineSingleton(NavigationWorld)
+		RNDefineMeta(NavigationWorld, RN::Object)
 		
-		NavigationWorld::NavigationWorld()
+		NavigationWorld::NavigationWorld(Mesh *mesh) :
+		_mesh(nullptr),
+		_overlay(std::make_shared<Overlay>()),
+		_lastObstacle(0)
 		{
-			
+			SetNavigationMesh(mesh);
 		}
 		
 		NavigationWorld::~NavigationWorld()
 		{
+			for(dtNavMeshQuery *query : _queries)
+				dtFreeNavMeshQuery(query);
 			
+			if(_mesh)
+				_mesh->Release();
 		}
 		
 		void NavigationWorld::SetNavigationMesh(Mesh *mesh)
 		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(mesh)
+				mesh->Retain();
+			if(_mesh)
+				_mesh->Release();
+			
+			_mesh = mesh;
+			_obstacles.clear();
+			
+			std::shared_ptr<Overlay> overlay = std::make_shared<Overlay>();
+			overlay->mesh = mesh;
+			
+			std::atomic_store(&_overlay, std::shared_ptr<const Overlay>(overlay));
+		}
+		
+		static std::atomic<uint64> _overlayRevision(0);
+		
+		void NavigationWorld::SetOverlay(std::shared_ptr<const Overlay> overlay)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			_obstacles.clear();
+			
+			if(!overlay || overlay->mesh != _mesh)
+			{
+				std::shared_ptr<Overlay> copy = overlay ? std::make_shared<Overlay>(*overlay) : std::make_shared<Overlay>();
+				copy->mesh = _mesh;
+				
+				overlay = copy;
+			}
+			
+			std::atomic_store(&_overlay, overlay);
+		}
+		
+		template<class F>
+		void NavigationWorld::ModifyOverlay(F &&function)
+		{
+			std::shared_ptr<Overlay> overlay = std::make_shared<Overlay>(*std::atomic_load(&_overlay));
+			function(*overlay);
+			
+			overlay->revision = ++ _overlayRevision;
+			
+			std::atomic_store(&_overlay, std::shared_ptr<const Overlay>(overlay));
+		}
+		
+		static void RemoveEmptyOverride(NavigationWorld::Overlay &overlay, dtPolyRef polygon)
+		{
+			auto iterator = overlay.polygons.find(polygon);
+			if(iterator != overlay.polygons.end() && !iterator->second.hasFlags && !iterator->second.hasArea && !iterator->second.obstacles)
+				overlay.polygons.erase(iterator);
+		}
+		
+		void NavigationWorld::SetPolygonFlags(dtPolyRef polygon, uint16 flags)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			ModifyOverlay([&](Overlay &overlay) {
+				PolygonOverride &polygonOverride = overlay.polygons[polygon];
+				polygonOverride.flags = flags;
+				polygonOverride.hasFlags = true;
+			});
+		}
+		
+		void NavigationWorld::SetPolygonArea(dtPolyRef polygon, uint8 area)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			ModifyOverlay([&](Overlay &overlay) {
+				PolygonOverride &polygonOverride = overlay.polygons[polygon];
+				polygonOverride.area = area;
+				polygonOverride.hasArea = true;
+			});
+		}
+		
+		void NavigationWorld::ResetPolygon(dtPolyRef polygon)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			ModifyOverlay([&](Overlay &overlay) {
+				auto iterator = overlay.polygons.find(polygon);
+				if(iterator == overlay.polygons.end())
+					return;
+				
+				iterator->second.hasFlags = false;
+				iterator->second.hasArea = false;
+				RemoveEmptyOverride(overlay, polygon);
+			});
+		}
+		
+		uint32 NavigationWorld::AddObstacle(const RN::Vector3 &position, float radius, float height)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(!_mesh)
+				return 0;
+			
+			std::vector<dtPolyRef> polygons(256);
+			int count = 0;
+			
+			{
+				EpochDomain::ReadGuard guard(_mesh->GetEpochDomain());
+				
+				dtNavMesh *navigationMesh = _mesh->GetDetourNavigationMesh();
+				if(!navigationMesh)
+					return 0;
+				
+				dtNavMeshQuery *query = AcquireQuery();
+				query->init(navigationMesh, 2048);
+				
+				// Every polygon, no matter what its flags are
+				dtQueryFilter filter;
+				filter.setIncludeFlags(0xffff);
+				
+				RN::Vector3 center(position.x, position.y + height * 0.5f, position.z);
+				RN::Vector3 extents(radius, height * 0.5f, radius);
+				
+				// Detour stops silently at the buffer size, so a full buffer may have missed polygons
+				while(true)
+				{
+					query->queryPolygons(&center.x, &extents.x, &filter, polygons.data(), &count, static_cast<int>(polygons.size()));
+					if(count < static_cast<int>(polygons.size()))
+						break;
+					
+					polygons.resize(polygons.size() * 2);
+				}
+				
+				ReleaseQuery(query);
+			}
+			
+			if(count == 0)
+				return 0;
+			
+			polygons.resize(count);
+			
+			ModifyOverlay([&](Overlay &overlay) {
+				for(dtPolyRef polygon : polygons)
+					overlay.polygons[polygon].obstacles ++;
+			});
+			
+			uint32 obstacle = ++ _lastObstacle;
+			_obstacles.emplace(obstacle, std::move(polygons));
+			
+			return obstacle;
+		}
+		
+		void NavigationWorld::RemoveObstacle(uint32 obstacle)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto iterator = _obstacles.find(obstacle);
+			if(iterator == _obstacles.end())
+				return;
+			
+			ModifyOverlay([&](Overlay &overlay) {
+				for(dtPolyRef polygon : iterator->second)
+				{
+					auto polygonIterator = overlay.polygons.find(polygon);
+					if(polygonIterator == overlay.polygons.end())
+						continue;
+					
+					polygonIterator->second.obstacles --;
+					RemoveEmptyOverride(overlay, polygon);
+				}
+			});
+			
+			_obstacles.erase(iterator);
+		}
+		
+		dtNavMeshQuery *NavigationWorld::AcquireQuery()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_queryLock);
+				
+				if(!_queries.empty())
+				{
+					dtNavMeshQuery *query = _queries.back();
+					_queries.pop_back();
+					
+					return query;
+				}
+			}
+			
+			return dtAllocNavMeshQuery();
+		}
+		
+		void NavigationWorld::ReleaseQuery(dtNavMeshQuery *query)
+		{
+			std::lock_guard<std::mutex> lock(_queryLock);
+			_queries.push_back(query);
+		}
+		
+		
+		bool WorldQueryFilter::passFilter(const dtPolyRef ref, const dtMeshTile *tile, const dtPoly *poly) const
+		{
+			unsigned short flags = poly->flags;
+			
+			if(_overlay)
+			{
+				auto iterator = _overlay->polygons.find(ref);
+				if(iterator != _overlay->polygons.end())
+				{
+					if(iterator->second.obstacles)
+						return false;
+					
+					if(iterator->second.hasFlags)
+						flags = iterator->second.flags;
+				}
+			}
+			
+			return (flags & getIncludeFlags()) != 0 && (flags & getExcludeFlags()) == 0;
+		}
+		
+		float WorldQueryFilter::getCost(const float *pa, const float *pb, const dtPolyRef prevRef, const dtMeshTile *prevTile, const dtPoly *prevPoly, const dtPolyRef curRef, const dtMeshTile *curTile, const dtPoly *curPoly, const dtPolyRef nextRef, const dtMeshTile *nextTile, const dtPoly *nextPoly) const
+		{
+			unsigned char area = curPoly->getArea();
+			
+			if(_overlay)
+			{
+				auto iterator = _overlay->polygons.find(curRef);
+				if(iterator != _overlay->polygons.end() && iterator->second.hasArea)
+					area = iterator->second.area;
+			}
 			
+			return dtVdist(pa, pb) * getAreaCost(area);
 		}
 	}
 }
@@ -20,22 +20,107 @@
 
 #include <Rayne/Rayne.h>
 
+#include <memory>
+#include <unordered_map>
+
+#include "RNNDetourConfig.h"
+
+#include "DetourNavMeshQuery.h"
 #include "RNNMesh.h"
 
 namespace RN
 {
 	namespace navigation
 	{
-		class NavigationWorld : public INonConstructingSingleton<NavigationWorld>
+		/// Per match navigation state on top of a shared Mesh. Any number of worlds can use the same
+		/// mesh, the baked tiles are never modified, polygon overrides and obstacles only live in the
+		/// world's overlay which Paths created for the world apply through their query filter.
+		class NavigationWorld : public RN::Object
 		{
 		public:
-			NavigationWorld();
+			struct PolygonOverride
+			{
+				PolygonOverride() :
+				flags(0), area(0), hasFlags(false), hasArea(false), obstacles(0)
+				{}
+				
+				uint16 flags;
+				uint8 area;
+				bool hasFlags;
+				bool hasArea;
+				uint32 obstacles;
+			};
+			
+			/// Immutable once published, changes copy it and swap the new one in.
+			struct Overlay
+			{
+				Overlay() :
+				revision(0), mesh(nullptr)
+				{}
+				
+				/// Unique across all worlds, 0 for an overlay that was never modified.
+				uint64 revision;
+				/// The mesh the polygon references belong to, Paths on any other mesh ignore the overlay.
+				const Mesh *mesh;
+				std::unordered_map<dtPolyRef, PolygonOverride> polygons;
+			};
+			
+			NavigationWorld(Mesh *mesh = nullptr);
 			~NavigationWorld();
 			
+			/// Replacing the mesh drops the overlay, Paths keep the mesh they were created with
+			/// and stop applying the world's overlay, whose polygons are the new mesh's.
 			void SetNavigationMesh(Mesh *mesh);
+			Mesh *GetNavigationMesh() const { return _mesh; }
+			
+			void SetPolygonFlags(dtPolyRef polygon, uint16 flags);
+			void SetPolygonArea(dtPolyRef polygon, uint8 area);
+			void ResetPolygon(dtPolyRef polygon);
+			
+			/// Blocks every polygon touching the bounds of the obstacle, returns 0 if there was none.
+			uint32 AddObstacle(const RN::Vector3 &position, float radius, float height);
+			void RemoveObstacle(uint32 obstacle);
+			
+			std::shared_ptr<const Overlay> GetOverlay() const { return std::atomic_load(&_overlay); }
+			/// Replaces the whole overlay, QueryReplay uses it to restore captured overlays.
+			/// The overlay is taken to be for the world's current mesh.
+			void SetOverlay(std::shared_ptr<const Overlay> overlay);
+			
+			dtNavMeshQuery *AcquireQuery();
+			void ReleaseQuery(dtNavMeshQuery *query);
+			
+		private:
+			template<class F>
+			void ModifyOverlay(F &&function);
+			
+			Mesh *_mesh;
+			std::shared_ptr<const Overlay> _overlay;
+			
+			std::mutex _lock;
+			std::unordered_map<uint32, std::vector<dtPolyRef>> _obstacles;
+			uint32 _lastObstacle;
+			
+			std::mutex _queryLock;
+			std::vector<dtNavMeshQuery *> _queries;
+			
+			RNDeclareMeta(NavigationWorld)
+		};
+		
+		/// Query filter applying the overlay of a NavigationWorld on top of the polygon data.
+		class WorldQueryFilter : public dtQueryFilter
+		{
+		public:
+			WorldQueryFilter() :
+			_overlay(nullptr)
+			{}
+			
+			void SetOverlay(const NavigationWorld::Overlay *overlay) { _overlay = (overlay && !overlay->polygons.empty()) ? overlay : nullptr; }
+			
+			virtual bool passFilter(const dtPolyRef ref, const dtMeshTile *tile, const dtPoly *poly) const;
+			virtual float getCost(const float *pa, const float *pb, const dtPolyRef prevRef, const dtMeshTile *prevTile, const dtPoly *prevPoly, const dtPolyRef curRef, const dtMeshTile *curTile, const dtPoly *curPoly, const dtPolyRef nextRef, const dtMeshTile *nextTile, const dtPoly *nextPoly) const;
 			
 		private:
-			RNDeclareSingleton(NavigationWorld)
+			const NavigationWorld::Overlay *_overlay;
 		};
 	}
 }
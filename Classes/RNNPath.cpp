@@ -7,58 +7,311 @@
 //
 
 #include "RNNPath.h"
+#include "RNNQueryCapture.h"
+#include "DetourNode.h"
+
+#include <cfloat>
 
 namespace RN
 {
 	namespace navigation
 	{
+		RaycastHit::RaycastHit() :
+		hit(false), t(1.0f)
+		{}
+		
+		
 		Path::Path(Mesh *navMesh) :
-		tolerance(RN::Vector3(4.0f)), _navMesh(navMesh)
+		tolerance(RN::Vector3(4.0f)), useLandmarks(false), smoothing(false), _navMesh(navMesh), _world(nullptr), _queryMesh(nullptr), _queryVersion(0)
 		{
 			_navMesh->Retain();
 			_query = dtAllocNavMeshQuery();
-			_query->init(_navMesh->GetDetourNavigationMesh(), 2048);
 			
 			_filter = new dtQueryFilter();
 		}
 		
+		Path::Path(NavigationWorld *world) :
+		tolerance(RN::Vector3(4.0f)), useLandmarks(false), smoothing(false), _navMesh(world->GetNavigationMesh()), _world(world), _queryMesh(nullptr), _queryVersion(0)
+		{
+			RN_ASSERT(_navMesh, "The world needs a navigation mesh.");
+			
+			_world->Retain();
+			_navMesh->Retain();
+			_query = _world->AcquireQuery();
+			
+			_filter = new WorldQueryFilter();
+		}
+		
 		Path::~Path()
 		{
 			_navMesh->Release();
-			dtFreeNavMeshQuery(_query);
 			delete _filter;
+			
+			if(_world)
+			{
+				_world->ReleaseQuery(_query);
+				_world->Release();
+			}
+			else
+			{
+				dtFreeNavMeshQuery(_query);
+			}
+		}
+		
+		bool Path::BindQuery(std::shared_ptr<const NavigationWorld::Overlay> &overlay)
+		{
+			uint64 versionHash;
+			dtNavMesh *navigationMesh = _navMesh->GetDetourNavigationMesh(versionHash);
+			if(!navigationMesh)
+				return false;
+			
+			// Tile updates publish a new mesh, rebind to whatever is current for this query
+			if(navigationMesh != _queryMesh)
+			{
+				_query->init(navigationMesh, 2048);
+				_queryMesh = navigationMesh;
+			}
+			
+			_queryVersion = versionHash;
+			
+			// The caller keeps the overlay alive until the query is done. After the world
+			// switched meshes its overlay references polygons of another mesh than ours.
+			if(_world)
+			{
+				overlay = _world->GetOverlay();
+				if(overlay->mesh != _navMesh)
+					overlay.reset();
+				
+				static_cast<WorldQueryFilter *>(_filter)->SetOverlay(overlay.get());
+			}
+			
+			return true;
 		}
 		
 		bool Path::FindPath(const RN::Vector3& start, const RN::Vector3& target)
 		{
-			dtPolyRef startPoly;
-			dtPolyRef targetPoly;
+			EpochDomain::ReadGuard guard(_navMesh->GetEpochDomain());
+			
+			std::shared_ptr<const NavigationWorld::Overlay> overlay;
+			if(!BindQuery(overlay))
+				return false;
+			
+			QueryStatistics *statistics = _navMesh->GetQueryStatistics();
+			bool recording = statistics->IsEnabled();
+			
+			QueryStatistics::Sample sample;
+			bool result = FindPath(start, target, sample, recording);
+			
+			if(recording)
+				statistics->Record(sample);
+			
+			QueryCapture *capture = _navMesh->GetQueryCapture();
+			if(capture)
+			{
+				// A failed query leaves the previous path in place, it is not part of the result
+				static const std::vector<RN::Vector3> empty;
+				uint8 options = (useLandmarks ? QueryCapture::UseLandmarksOption : 0) | (smoothing ? QueryCapture::SmoothingOption : 0);
+				capture->Record(_queryVersion, _filter, overlay.get(), options, start, target, tolerance, sample.result, result ? _path : empty);
+			}
+			
+			return result;
+		}
+		
+		bool Path::FindPath(const RN::Vector3& start, const RN::Vector3& target, QueryStatistics::Sample &sample, bool recording)
+		{
+			uint64 timestamp = recording ? QueryStatistics::GetTimestamp() : 0;
+			
+			dtPolyRef startPoly = 0;
+			dtPolyRef targetPoly = 0;
 			
 			_query->findNearestPoly(&start.x, &tolerance.x, _filter, &startPoly, nullptr);
 			_query->findNearestPoly(&target.x, &tolerance.x, _filter, &targetPoly, nullptr);
 			
-			if(startPoly && targetPoly)
+			if(recording)
+				sample.nearestPolyTime = Lap(timestamp);
+			
+			if(!startPoly || !targetPoly)
+			{
+				sample.result = QueryStatistics::NoPolygon;
+				return false;
+			}
+			
+			int outCount = 0;
+			std::vector<dtPolyRef> path(2048);
+			
+			// The table is only usable with the exact mesh it was built for
+			std::shared_ptr<const LandmarkTable> landmarks;
+			if(useLandmarks)
+			{
+				landmarks = _navMesh->GetLandmarks();
+				if(landmarks && !landmarks->IsValidFor(_queryMesh, _queryVersion))
+					landmarks.reset();
+			}
+			
+			// The node pool is about as large as the rest of the Path, most never search with landmarks
+			if(landmarks && !_landmarkSearch)
+				_landmarkSearch.reset(new LandmarkSearch());
+			
+			dtStatus pathStatus;
+			if(landmarks)
+				pathStatus = _landmarkSearch->FindPath(*landmarks, _queryMesh, _filter, startPoly, targetPoly, path.data(), &outCount, static_cast<int>(path.capacity()));
+			else
+				pathStatus = _query->findPath(startPoly, targetPoly, &start.x, &target.x, _filter, path.data(), &outCount, static_cast<int>(path.capacity()));
+			
+			path.resize(outCount);
+			
+			if(recording)
 			{
-				int outCount;
-				std::vector<dtPolyRef> path(2048);
+				sample.findPathTime = Lap(timestamp);
+				sample.nodes = landmarks ? _landmarkSearch->GetNodeCount() : static_cast<uint32>(_query->getNodePool()->getNodeCount());
+				sample.polygons = static_cast<uint32>(outCount);
+			}
+			
+			if(dtStatusFailed(pathStatus) || !outCount)
+			{
+				sample.result = QueryStatistics::Failed;
+				return false;
+			}
+			
+			_path.resize(2048);
+			
+			std::vector<dtPolyRef> references;
+			if(smoothing)
+				references.resize(_path.size());
+			
+			dtStatus straightStatus = _query->findStraightPath(&start.x, &target.x, path.data(), static_cast<int>(path.size()), reinterpret_cast<float *>(_path.data()), nullptr, smoothing ? references.data() : nullptr, &outCount, static_cast<int>(_path.capacity()));
+			_path.resize(outCount);
+			
+			if(smoothing)
+			{
+				references.resize(outCount);
+				SmoothPath(path, references);
 				
-				_query->findPath(startPoly, targetPoly, &start.x, &target.x, _filter, path.data(), &outCount, static_cast<int>(path.capacity()));
+				outCount = static_cast<int>(_path.size());
+			}
+			
+			std::reverse(_path.begin(), _path.end());
+			
+			if(recording)
+			{
+				sample.straightPathTime = Lap(timestamp);
+				sample.points = static_cast<uint32>(outCount);
+			}
+			
+			if(dtStatusDetail(pathStatus, DT_BUFFER_TOO_SMALL) || dtStatusDetail(straightStatus, DT_BUFFER_TOO_SMALL))
+				sample.result = QueryStatistics::Truncated;
+			else if(dtStatusDetail(pathStatus, DT_PARTIAL_RESULT) || dtStatusDetail(pathStatus, DT_OUT_OF_NODES))
+				sample.result = QueryStatistics::Partial;
+			else
+				sample.result = QueryStatistics::Success;
+			
+			return true;
+		}
+		
+		void Path::SmoothPath(const std::vector<dtPolyRef> &corridor, const std::vector<dtPolyRef> &references)
+		{
+			if(_path.size() < 3)
+				return;
+			
+			// Where each straight path point lies in the corridor, the end point has no reference
+			std::vector<size_t> corridorIndices(references.size(), corridor.size() - 1);
+			for(size_t i = 0, j = 0; i < references.size() && j < corridor.size(); i++)
+			{
+				while(j < corridor.size() - 1 && corridor[j] != references[i])
+					j ++;
 				
-				path.resize(outCount);
+				corridorIndices[i] = j;
+			}
+			
+			// Extends each straight segment as far as the ray stays on the mesh, the end point is always kept.
+			// The ray only checks passFilter(), so a shortcut must not trade the corridor's area cost for another.
+			size_t count = 1;
+			size_t anchor = 0;
+			
+			for(size_t i = 1; i < _path.size() - 1; i++)
+			{
+				float t;
+				float normal[3];
+				int visitedCount = 0;
+				dtPolyRef visited[16];
 				
-				if(outCount)
+				dtStatus status = _query->raycast(references[anchor], &_path[anchor].x, &_path[i + 1].x, _filter, &t, normal, visited, &visitedCount, 16);
+				if(dtStatusSucceed(status) && !dtStatusDetail(status, DT_BUFFER_TOO_SMALL) && t == FLT_MAX)
 				{
-					_path.resize(2048);
+					float cost = GetAreaCost(corridor[corridorIndices[anchor]]);
+					bool sameCost = true;
+					
+					for(size_t j = corridorIndices[anchor]; j <= corridorIndices[i + 1] && sameCost; j++)
+						sameCost = (GetAreaCost(corridor[j]) == cost);
 					
-					_query->findStraightPath(&start.x, &target.x, path.data(), static_cast<int>(path.size()), reinterpret_cast<float *>(_path.data()), nullptr, nullptr, &outCount, static_cast<int>(_path.capacity()));
-					_path.resize(outCount);
+					for(int j = 0; j < visitedCount && sameCost; j++)
+						sameCost = (GetAreaCost(visited[j]) == cost);
 					
-					std::reverse(_path.begin(), _path.end());
-					return true;
+					if(sameCost)
+						continue;
 				}
+				
+				_path[count ++] = _path[i];
+				anchor = i;
 			}
 			
-			return false;
+			_path[count ++] = _path.back();
+			_path.resize(count);
+		}
+		
+		float Path::GetAreaCost(dtPolyRef polygon) const
+		{
+			const dtMeshTile *tile;
+			const dtPoly *poly;
+			_queryMesh->getTileAndPolyByRefUnsafe(polygon, &tile, &poly);
+			
+			// The cost over a unit distance, with the area overrides of a world filter
+			static const float origin[3] = { 0.0f, 0.0f, 0.0f };
+			static const float unit[3] = { 1.0f, 0.0f, 0.0f };
+			
+			return _filter->getCost(origin, unit, 0, nullptr, nullptr, polygon, tile, poly, 0, nullptr, nullptr);
+		}
+		
+		bool Path::Raycast(const RN::Vector3& start, const RN::Vector3& target, RaycastHit &hit)
+		{
+			EpochDomain::ReadGuard guard(_navMesh->GetEpochDomain());
+			
+			std::shared_ptr<const NavigationWorld::Overlay> overlay;
+			if(!BindQuery(overlay))
+				return false;
+			
+			dtPolyRef startPoly = 0;
+			_query->findNearestPoly(&start.x, &tolerance.x, _filter, &startPoly, nullptr);
+			
+			if(!startPoly)
+				return false;
+			
+			float t;
+			int visitedCount = 0;
+			dtPolyRef visited[16];
+			
+			dtStatus status = _query->raycast(startPoly, &start.x, &target.x, _filter, &t, &hit.normal.x, visited, &visitedCount, 16);
+			if(dtStatusFailed(status))
+				return false;
+			
+			// Detour reports FLT_MAX when the target was reached
+			hit.hit = (t != FLT_MAX);
+			hit.t = hit.hit ? t : 1.0f;
+			hit.position = start + (target - start) * hit.t;
+			
+			if(!hit.hit)
+				hit.normal = RN::Vector3();
+			
+			return true;
+		}
+		
+		uint64 Path::Lap(uint64 &timestamp)
+		{
+			uint64 now = QueryStatistics::GetTimestamp();
+			uint64 elapsed = now - timestamp;
+			
+			timestamp = now;
+			return elapsed;
 		}
 		
 		const RN::Vector3& Path::GetClosestPoint() const
@@ -11,35 +11,77 @@
 
 #include <Rayne/Rayne.h>
 
+#include "RNNDetourConfig.h"
+
 #include "DetourNavMeshQuery.h"
 #include "RNNMesh.h"
+#include "RNNNavigationWorld.h"
 
 namespace RN
 {
 	namespace navigation
 	{
+		struct RaycastHit
+		{
+			RaycastHit();
+			
+			bool hit;
+			/// Fraction of the way to the target where the ray stopped, 1 without a hit.
+			float t;
+			RN::Vector3 position;
+			RN::Vector3 normal;
+		};
+		
 		class Path
 		{
 		public:
 			Path(Mesh *navMesh);
+			/// Uses the world's mesh, overlay and query pool.
+			Path(NavigationWorld *world);
 			~Path();
 			
 			bool FindPath(const RN::Vector3& start, const RN::Vector3& target);
 			
+			/// Walks straight along the mesh surface towards the target, heights are ignored.
+			/// Returns false if there is no polygon at the start, see RaycastBatch for many rays at once.
+			bool Raycast(const RN::Vector3& start, const RN::Vector3& target, RaycastHit &hit);
+			
 			const RN::Vector3& GetClosestPoint() const;
 			void PopPoint();
 			bool IsAtEnd();
 			
+			/// The remaining points, the closest one is the last.
+			const std::vector<RN::Vector3> &GetPoints() const { return _path; }
+			dtQueryFilter *GetFilter() { return _filter; }
+			
 			RN::Vector3 tolerance;
 			
+			/// Searches with the mesh's landmark table if it has a valid one, see Mesh::BuildLandmarks().
+			/// Corridors follow polygon centroids instead of Detour's edge midpoints, so they can differ slightly.
+			bool useLandmarks;
+			/// Drops corners that can be skipped by walking straight, using one raycast per corner.
+			/// Detour's corridor corners are already taut, this mostly helps partial and landmark paths.
+			/// Corners are only dropped if the shortcut and the corridor it replaces have one area cost.
+			bool smoothing;
+			
 		private:
+			bool BindQuery(std::shared_ptr<const NavigationWorld::Overlay> &overlay);
+			bool FindPath(const RN::Vector3& start, const RN::Vector3& target, QueryStatistics::Sample &sample, bool recording);
+			void SmoothPath(const std::vector<dtPolyRef> &corridor, const std::vector<dtPolyRef> &references);
+			float GetAreaCost(dtPolyRef polygon) const;
+			static uint64 Lap(uint64 &timestamp);
+			
 			Mesh *_navMesh;
+			NavigationWorld *_world;
+			dtNavMesh *_queryMesh;
+			uint64 _queryVersion;
 			
 			dtPolyRef _startRef;
 			dtPolyRef _targetRef;
 			
 			dtQueryFilter *_filter;
 			dtNavMeshQuery *_query;
+			std::unique_ptr<LandmarkSearch> _landmarkSearch;
 			
 			std::vector<RN::Vector3> _path;
 		};
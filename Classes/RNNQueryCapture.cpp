@@ -0,0 +1,399 @@
+//
+//  RNNQueryCapture.cpp
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RNNQueryCapture.h"
+#include "RNNPath.h"
+
+#include <thread>
+
+namespace RN
+{
+	namespace navigation
+	{
+		RNDefineMeta(QueryCapture, RN::Object)
+		
+		const uint32 QueryCapture::Magic;
+		const uint32 QueryCapture::Version;
+		
+		template<class T>
+		static inline bool Write(FILE *file, const T &value)
+		{
+			return (fwrite(&value, sizeof(T), 1, file) == 1);
+		}
+		
+		template<class T>
+		static inline bool Read(FILE *file, T &value)
+		{
+			return (fread(&value, sizeof(T), 1, file) == 1);
+		}
+		
+		static inline bool WriteVector(FILE *file, const RN::Vector3 &vector)
+		{
+			return Write(file, vector.x) && Write(file, vector.y) && Write(file, vector.z);
+		}
+		
+		static inline bool ReadVector(FILE *file, RN::Vector3 &vector)
+		{
+			return Read(file, vector.x) && Read(file, vector.y) && Read(file, vector.z);
+		}
+		
+		
+		QueryCapture::QueryCapture(const char *path) :
+		_hasState(false),
+		_meshVersion(0),
+		_overlayRevision(0)
+		{
+			_file = fopen(path, "wb");
+			if(_file)
+			{
+				Write(_file, Magic);
+				Write(_file, Version);
+			}
+		}
+		
+		QueryCapture::~QueryCapture()
+		{
+			if(_file)
+				fclose(_file);
+		}
+		
+		void QueryCapture::Record(uint64 meshVersion, const dtQueryFilter *filter, const NavigationWorld::Overlay *overlay, uint8 options, const RN::Vector3 &start, const RN::Vector3 &target, const RN::Vector3 &extents, QueryStatistics::Result result, const std::vector<RN::Vector3> &points)
+		{
+			if(!_file)
+				return;
+			
+			Filter current;
+			current.includeFlags = filter->getIncludeFlags();
+			current.excludeFlags = filter->getExcludeFlags();
+			
+			for(int i = 0; i < DT_MAX_AREAS; i++)
+				current.areaCosts[i] = filter->getAreaCost(i);
+			
+			uint32 pathHash = HashPoints(points);
+			
+			// An empty overlay filters exactly like none, both replay on the plain mesh
+			if(overlay && overlay->polygons.empty())
+				overlay = nullptr;
+			
+			uint64 overlayRevision = overlay ? overlay->revision : 0;
+			
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(!_hasState || _meshVersion != meshVersion)
+			{
+				Write(_file, static_cast<uint8>(MeshVersionRecord));
+				Write(_file, meshVersion);
+				
+				_meshVersion = meshVersion;
+			}
+			
+			if(!_hasState || memcmp(&_filter, &current, sizeof(Filter)) != 0)
+			{
+				// Only costs that differ from the default are stored
+				uint8 count = 0;
+				for(int i = 0; i < DT_MAX_AREAS; i++)
+				{
+					if(current.areaCosts[i] != 1.0f)
+						count ++;
+				}
+				
+				Write(_file, static_cast<uint8>(FilterRecord));
+				Write(_file, current.includeFlags);
+				Write(_file, current.excludeFlags);
+				Write(_file, count);
+				
+				for(int i = 0; i < DT_MAX_AREAS; i++)
+				{
+					if(current.areaCosts[i] != 1.0f)
+					{
+						Write(_file, static_cast<uint8>(i));
+						Write(_file, current.areaCosts[i]);
+					}
+				}
+				
+				_filter = current;
+			}
+			
+			if(!_hasState || _overlayRevision != overlayRevision)
+			{
+				Write(_file, static_cast<uint8>(OverlayRecord));
+				Write(_file, static_cast<uint32>(overlay ? overlay->polygons.size() : 0));
+				
+				if(overlay)
+				{
+					for(const auto &polygon : overlay->polygons)
+					{
+						Write(_file, polygon.first);
+						Write(_file, polygon.second.flags);
+						Write(_file, polygon.second.area);
+						Write(_file, static_cast<uint8>((polygon.second.hasFlags ? 1 : 0) | (polygon.second.hasArea ? 2 : 0)));
+						Write(_file, polygon.second.obstacles);
+					}
+				}
+				
+				_overlayRevision = overlayRevision;
+			}
+			
+			_hasState = true;
+			
+			Write(_file, static_cast<uint8>(QueryRecord));
+			Write(_file, options);
+			WriteVector(_file, start);
+			WriteVector(_file, target);
+			WriteVector(_file, extents);
+			Write(_file, static_cast<uint8>(result));
+			Write(_file, static_cast<uint16>(std::min(points.size(), static_cast<size_t>(0xffff))));
+			Write(_file, pathHash);
+		}
+		
+		void QueryCapture::Flush()
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(_file)
+				fflush(_file);
+		}
+		
+		uint32 QueryCapture::HashPoints(const std::vector<RN::Vector3> &points)
+		{
+			uint32 hash = 2166136261U;
+			for(const RN::Vector3 &point : points)
+			{
+				const uint8 *bytes = reinterpret_cast<const uint8 *>(&point.x);
+				for(size_t i = 0; i < sizeof(float) * 3; i++)
+				{
+					hash ^= bytes[i];
+					hash *= 16777619U;
+				}
+			}
+			
+			return hash;
+		}
+		
+		
+		void QueryReplay::Filter::Apply(dtQueryFilter *filter) const
+		{
+			filter->setIncludeFlags(includeFlags);
+			filter->setExcludeFlags(excludeFlags);
+			
+			for(int i = 0; i < DT_MAX_AREAS; i++)
+				filter->setAreaCost(i, 1.0f);
+			
+			for(const std::pair<uint8, float> &cost : areaCosts)
+				filter->setAreaCost(cost.first, cost.second);
+		}
+		
+		QueryReplay::Report::Report() :
+		queries(0),
+		mismatches(0),
+		versionMismatches(0),
+		seconds(0.0)
+		{}
+		
+		bool QueryReplay::Load(const char *path)
+		{
+			_filters.clear();
+			_overlays.clear();
+			_queries.clear();
+			
+			FILE *file = fopen(path, "rb");
+			if(!file)
+				return false;
+			
+			uint32 magic;
+			uint32 version;
+			
+			if(!Read(file, magic) || !Read(file, version) || magic != QueryCapture::Magic || version != QueryCapture::Version)
+			{
+				fclose(file);
+				return false;
+			}
+			
+			uint64 meshVersion = 0;
+			size_t overlay = NoOverlay;
+			bool success = true;
+			uint8 type;
+			
+			while(success && Read(file, type))
+			{
+				switch(type)
+				{
+					case QueryCapture::MeshVersionRecord:
+					{
+						success = Read(file, meshVersion);
+						break;
+					}
+					
+					case QueryCapture::FilterRecord:
+					{
+						Filter filter;
+						uint8 count;
+						
+						success = Read(file, filter.includeFlags) && Read(file, filter.excludeFlags) && Read(file, count);
+						
+						for(uint8 i = 0; i < count && success; i++)
+						{
+							std::pair<uint8, float> cost;
+							success = Read(file, cost.first) && Read(file, cost.second);
+							
+							filter.areaCosts.push_back(cost);
+						}
+						
+						_filters.push_back(std::move(filter));
+						break;
+					}
+					
+					case QueryCapture::OverlayRecord:
+					{
+						std::shared_ptr<NavigationWorld::Overlay> loaded = std::make_shared<NavigationWorld::Overlay>();
+						uint32 count;
+						
+						success = Read(file, count);
+						
+						for(uint32 i = 0; i < count && success; i++)
+						{
+							dtPolyRef polygon;
+							uint8 has;
+							NavigationWorld::PolygonOverride polygonOverride;
+							
+							success = Read(file, polygon) && Read(file, polygonOverride.flags) && Read(file, polygonOverride.area) && Read(file, has) && Read(file, polygonOverride.obstacles);
+							
+							polygonOverride.hasFlags = (has & 1);
+							polygonOverride.hasArea = (has & 2);
+							loaded->polygons[polygon] = polygonOverride;
+						}
+						
+						if(count == 0)
+						{
+							overlay = NoOverlay;
+						}
+						else
+						{
+							overlay = _overlays.size();
+							_overlays.push_back(loaded);
+						}
+						
+						break;
+					}
+					
+					case QueryCapture::QueryRecord:
+					{
+						Query query;
+						uint8 result;
+						
+						query.meshVersion = meshVersion;
+						query.filter = _filters.size() - 1;
+						query.overlay = overlay;
+						
+						success = Read(file, query.options) && !_filters.empty() && ReadVector(file, query.start) && ReadVector(file, query.target) && ReadVector(file, query.extents);
+						success = success && Read(file, result) && Read(file, query.points) && Read(file, query.pathHash);
+						
+						query.result = static_cast<QueryStatistics::Result>(result);
+						
+						if(success)
+							_queries.push_back(query);
+						
+						break;
+					}
+					
+					default:
+						success = false;
+						break;
+				}
+			}
+			
+			fclose(file);
+			return success;
+		}
+		
+		QueryReplay::Report QueryReplay::Run(Mesh *mesh, size_t threadCount) const
+		{
+			threadCount = std::max(threadCount, static_cast<size_t>(1));
+			
+			uint64 meshVersion = mesh->GetVersionHash();
+			
+			std::atomic<size_t> mismatches(0);
+			std::atomic<size_t> versionMismatches(0);
+			
+			auto replay = [&](size_t offset) {
+				// Overlay queries run through a world of their own per thread, the rest on the plain mesh
+				NavigationWorld *world = new NavigationWorld(mesh);
+				
+				Path meshPath(mesh);
+				Path worldPath(world);
+				
+				size_t currentOverlay = NoOverlay;
+				
+				size_t localMismatches = 0;
+				size_t localVersionMismatches = 0;
+				
+				for(size_t i = offset; i < _queries.size(); i += threadCount)
+				{
+					const Query &query = _queries[i];
+					
+					if(query.overlay != NoOverlay && query.overlay != currentOverlay)
+					{
+						world->SetOverlay(_overlays[query.overlay]);
+						currentOverlay = query.overlay;
+					}
+					
+					Path &path = (query.overlay != NoOverlay) ? worldPath : meshPath;
+					
+					_filters[query.filter].Apply(path.GetFilter());
+					path.tolerance = query.extents;
+					path.useLandmarks = (query.options & QueryCapture::UseLandmarksOption);
+					path.smoothing = (query.options & QueryCapture::SmoothingOption);
+					
+					bool found = path.FindPath(query.start, query.target);
+					
+					size_t points = found ? path.GetPoints().size() : 0;
+					uint32 pathHash = QueryCapture::HashPoints(found ? path.GetPoints() : std::vector<RN::Vector3>());
+					
+					if(points != query.points || pathHash != query.pathHash)
+						localMismatches ++;
+					
+					if(query.meshVersion != meshVersion)
+						localVersionMismatches ++;
+				}
+				
+				mismatches += localMismatches;
+				versionMismatches += localVersionMismatches;
+				
+				world->Release();
+			};
+			
+			auto start = std::chrono::steady_clock::now();
+			
+			std::vector<std::thread> threads;
+			for(size_t i = 1; i < threadCount; i++)
+				threads.emplace_back(replay, i);
+			
+			replay(0);
+			
+			for(std::thread &thread : threads)
+				thread.join();
+			
+			Report report;
+			report.queries = _queries.size();
+			report.mismatches = mismatches.load();
+			report.versionMismatches = versionMismatches.load();
+			report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			
+			return report;
+		}
+	}
+}
@@ -0,0 +1,147 @@
+//
+//  RNNQueryCapture.h
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __rayne_navigation__RNNQueryCapture__
+#define __rayne_navigation__RNNQueryCapture__
+
+#include <Rayne/Rayne.h>
+
+#include "RNNDetourConfig.h"
+
+#include "DetourNavMeshQuery.h"
+#include "RNNMesh.h"
+#include "RNNNavigationWorld.h"
+#include "RNNStatistics.h"
+
+namespace RN
+{
+	namespace navigation
+	{
+		/// Writes every path query run on a mesh into a binary log, see Mesh::SetQueryCapture().
+		/// The log is a stream of records, mesh version, filter and overlay records are only
+		/// written when they differ from the previous ones, so most records are plain queries.
+		class QueryCapture : public RN::Object
+		{
+		public:
+			enum RecordType
+			{
+				MeshVersionRecord = 1,
+				FilterRecord = 2,
+				QueryRecord = 3,
+				OverlayRecord = 4
+			};
+			
+			/// Path settings stored with every query.
+			enum QueryOption
+			{
+				UseLandmarksOption = 1 << 0,
+				SmoothingOption = 1 << 1
+			};
+			
+			static const uint32 Magic = 'R'<<24 | 'N'<<16 | 'Q'<<8 | 'C';
+			static const uint32 Version = 2;
+			
+			QueryCapture(const char *path);
+			~QueryCapture();
+			
+			bool IsOpen() const { return (_file != nullptr); }
+			
+			/// The overlay is the one of the Path's world, nullptr or an empty one for plain mesh queries.
+			void Record(uint64 meshVersion, const dtQueryFilter *filter, const NavigationWorld::Overlay *overlay, uint8 options, const RN::Vector3 &start, const RN::Vector3 &target, const RN::Vector3 &extents, QueryStatistics::Result result, const std::vector<RN::Vector3> &points);
+			void Flush();
+			
+			static uint32 HashPoints(const std::vector<RN::Vector3> &points);
+			
+		private:
+			struct Filter
+			{
+				uint16 includeFlags;
+				uint16 excludeFlags;
+				float areaCosts[DT_MAX_AREAS];
+			};
+			
+			std::mutex _lock;
+			FILE *_file;
+			
+			bool _hasState;
+			uint64 _meshVersion;
+			uint64 _overlayRevision;
+			Filter _filter;
+			
+			RNDeclareMeta(QueryCapture)
+		};
+		
+		/// Replays a query log against a mesh, usually one loaded with Mesh::ReadFromFile().
+		class QueryReplay
+		{
+		public:
+			struct Filter
+			{
+				void Apply(dtQueryFilter *filter) const;
+				
+				uint16 includeFlags;
+				uint16 excludeFlags;
+				std::vector<std::pair<uint8, float>> areaCosts;
+			};
+			
+			struct Query
+			{
+				uint64 meshVersion;
+				size_t filter;
+				/// Index into the overlays, NoOverlay for plain mesh queries.
+				size_t overlay;
+				uint8 options;
+				
+				RN::Vector3 start;
+				RN::Vector3 target;
+				RN::Vector3 extents;
+				
+				QueryStatistics::Result result;
+				uint16 points;
+				uint32 pathHash;
+			};
+			
+			struct Report
+			{
+				Report();
+				
+				double GetQueriesPerSecond() const { return (seconds > 0.0) ? queries / seconds : 0.0; }
+				
+				size_t queries;
+				size_t mismatches;
+				size_t versionMismatches;
+				double seconds;
+			};
+			
+			bool Load(const char *path);
+			
+			/// Runs all queries spread over the given number of threads, each with its own Path.
+			Report Run(Mesh *mesh, size_t threadCount) const;
+			
+			const std::vector<Query> &GetQueries() const { return _queries; }
+			
+			static const size_t NoOverlay = static_cast<size_t>(-1);
+			
+		private:
+			std::vector<Filter> _filters;
+			std::vector<std::shared_ptr<const NavigationWorld::Overlay>> _overlays;
+			std::vector<Query> _queries;
+		};
+	}
+}
+
+#endif /* defined(__rayne_navigation__RNNQueryCapture__) */
@@ -0,0 +1,176 @@
+//
+//  RNNRaycastBatch.cpp
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RNNRaycastBatch.h"
+
+namespace RN
+{
+	namespace navigation
+	{
+		// Below this many rays per thread waking workers costs more than it saves
+		static const size_t MinRaysPerThread = 64;
+		
+		RaycastBatch::RaycastBatch(Mesh *mesh, size_t threadCount)
+		{
+			for(size_t i = 0; i < std::max(threadCount, static_cast<size_t>(1)); i++)
+				_paths.push_back(new Path(mesh));
+			
+			Initialize(threadCount);
+		}
+		
+		RaycastBatch::RaycastBatch(NavigationWorld *world, size_t threadCount)
+		{
+			for(size_t i = 0; i < std::max(threadCount, static_cast<size_t>(1)); i++)
+				_paths.push_back(new Path(world));
+			
+			Initialize(threadCount);
+		}
+		
+		RaycastBatch::~RaycastBatch()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				_stopping = true;
+			}
+			
+			_workAvailable.notify_all();
+			
+			for(std::thread &worker : _workers)
+				worker.join();
+			
+			for(Path *path : _paths)
+				delete path;
+		}
+		
+		void RaycastBatch::Initialize(size_t threadCount)
+		{
+			_generation = 0;
+			_pending = 0;
+			_stopping = false;
+			_rays = nullptr;
+			_hits = nullptr;
+			_count = 0;
+			_chunk = 0;
+			_activeThreads = 0;
+			
+			// The calling thread takes the first share, so it needs no worker of its own
+			for(size_t i = 1; i < _paths.size(); i++)
+				_workers.emplace_back(&RaycastBatch::WorkerLoop, this, i);
+		}
+		
+		void RaycastBatch::WorkerLoop(size_t index)
+		{
+			uint64 generation = 0;
+			
+			while(true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(_lock);
+					_workAvailable.wait(lock, [&]() { return _stopping || _generation != generation; });
+					
+					if(_stopping)
+						return;
+					
+					generation = _generation;
+					
+					if(index >= _activeThreads)
+						continue;
+				}
+				
+				Cast(index);
+				
+				bool done;
+				{
+					std::lock_guard<std::mutex> lock(_lock);
+					done = (-- _pending == 0);
+				}
+				
+				if(done)
+					_workDone.notify_one();
+			}
+		}
+		
+		void RaycastBatch::SetFilter(const dtQueryFilter *filter)
+		{
+			for(Path *path : _paths)
+			{
+				dtQueryFilter *target = path->GetFilter();
+				target->setIncludeFlags(filter->getIncludeFlags());
+				target->setExcludeFlags(filter->getExcludeFlags());
+				
+				for(int i = 0; i < DT_MAX_AREAS; i++)
+					target->setAreaCost(i, filter->getAreaCost(i));
+			}
+		}
+		
+		void RaycastBatch::SetTolerance(const RN::Vector3 &tolerance)
+		{
+			for(Path *path : _paths)
+				path->tolerance = tolerance;
+		}
+		
+		void RaycastBatch::Cast(size_t index)
+		{
+			Path *path = _paths[index];
+			size_t end = std::min(_count, (index + 1) * _chunk);
+			
+			for(size_t i = index * _chunk; i < end; i++)
+			{
+				RaycastHit &hit = _hits[i];
+				if(!path->Raycast(_rays[i].start, _rays[i].target, hit))
+				{
+					hit = RaycastHit();
+					hit.hit = true;
+					hit.t = 0.0f;
+					hit.position = _rays[i].start;
+				}
+			}
+		}
+		
+		void RaycastBatch::Run(const Ray *rays, RaycastHit *hits, size_t count)
+		{
+			size_t threadCount = std::min(_paths.size(), std::max(count / MinRaysPerThread, static_cast<size_t>(1)));
+			
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				
+				// Contiguous ranges, so neighbouring rays share cached tiles
+				_rays = rays;
+				_hits = hits;
+				_count = count;
+				_chunk = (count + threadCount - 1) / threadCount;
+				_activeThreads = threadCount;
+				_pending = threadCount - 1;
+				_generation ++;
+			}
+			
+			if(threadCount > 1)
+				_workAvailable.notify_all();
+			
+			Cast(0);
+			
+			std::unique_lock<std::mutex> lock(_lock);
+			_workDone.wait(lock, [&]() { return _pending == 0; });
+		}
+		
+		void RaycastBatch::Run(const std::vector<Ray> &rays, std::vector<RaycastHit> &hits)
+		{
+			hits.resize(rays.size());
+			Run(rays.data(), hits.data(), rays.size());
+		}
+	}
+}
@@ -0,0 +1,83 @@
+//
+//  RNNRaycastBatch.h
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __rayne_navigation__RNNRaycastBatch__
+#define __rayne_navigation__RNNRaycastBatch__
+
+#include <Rayne/Rayne.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "RNNPath.h"
+
+namespace RN
+{
+	namespace navigation
+	{
+		/// Casts many rays at once. The worker threads and the Path each of them uses for its query
+		/// and filter live as long as the batch, so one batch can be reused every frame.
+		/// Run() is not reentrant, use one batch per calling thread.
+		class RaycastBatch
+		{
+		public:
+			struct Ray
+			{
+				RN::Vector3 start;
+				RN::Vector3 target;
+			};
+			
+			RaycastBatch(Mesh *mesh, size_t threadCount);
+			RaycastBatch(NavigationWorld *world, size_t threadCount);
+			~RaycastBatch();
+			
+			/// Copies flags and area costs into the filters of all workers.
+			void SetFilter(const dtQueryFilter *filter);
+			void SetTolerance(const RN::Vector3 &tolerance);
+			
+			/// Blocks until all rays are cast. Rays starting off the mesh count as a hit at their start.
+			void Run(const Ray *rays, RaycastHit *hits, size_t count);
+			void Run(const std::vector<Ray> &rays, std::vector<RaycastHit> &hits);
+			
+		private:
+			void Initialize(size_t threadCount);
+			void Cast(size_t index);
+			void WorkerLoop(size_t index);
+			
+			std::vector<Path *> _paths;
+			std::vector<std::thread> _workers;
+			
+			std::mutex _lock;
+			std::condition_variable _workAvailable;
+			std::condition_variable _workDone;
+			
+			uint64 _generation;
+			size_t _pending;
+			bool _stopping;
+			
+			const Ray *_rays;
+			RaycastHit *_hits;
+			size_t _count;
+			size_t _chunk;
+			size_t _activeThreads;
+		};
+	}
+}
+
+#endif /* defined(__rayne_navigation__RNNRaycastBatch__) */
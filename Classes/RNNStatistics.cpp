@@ -0,0 +1,170 @@
+//
+//  RNNStatistics.cpp
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RNNStatistics.h"
+
+namespace RN
+{
+	namespace navigation
+	{
+		static size_t GetBucket(uint64 value)
+		{
+			size_t bucket = 0;
+			while(value && bucket < QueryStatistics::Histogram::BucketCount - 1)
+			{
+				value >>= 1;
+				bucket ++;
+			}
+			
+			return bucket;
+		}
+		
+		// Only the owning thread writes, so plain load/store pairs are enough and avoid locked instructions
+		static inline void Increment(std::atomic<uint64> &counter, uint64 value)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+		
+		
+		QueryStatistics::Histogram::Histogram() :
+		count(0), sum(0), max(0)
+		{
+			std::fill(buckets, buckets + BucketCount, 0);
+		}
+		
+		uint64 QueryStatistics::Histogram::GetPercentile(float percentile) const
+		{
+			if(count == 0)
+				return 0;
+			
+			uint64 target = static_cast<uint64>(std::ceil(count * std::min(std::max(percentile, 0.0f), 1.0f)));
+			uint64 seen = 0;
+			
+			for(size_t i = 0; i < BucketCount; i ++)
+			{
+				seen += buckets[i];
+				if(seen >= target && seen > 0)
+					return std::min((i == 0) ? 0 : (static_cast<uint64>(1) << i) - 1, max);
+			}
+			
+			return max;
+		}
+		
+		QueryStatistics::Sample::Sample() :
+		result(Failed),
+		nearestPolyTime(0),
+		findPathTime(0),
+		straightPathTime(0),
+		nodes(0),
+		polygons(0),
+		points(0)
+		{}
+		
+		QueryStatistics::Snapshot::Snapshot() :
+		queries(0)
+		{
+			std::fill(results, results + ResultCount, 0);
+		}
+		
+		
+		QueryStatistics::Recorder::AtomicHistogram::AtomicHistogram() :
+		count(0), sum(0), max(0)
+		{
+			for(size_t i = 0; i < Histogram::BucketCount; i ++)
+				buckets[i].store(0, std::memory_order_relaxed);
+		}
+		
+		void QueryStatistics::Recorder::AtomicHistogram::Add(uint64 value)
+		{
+			Increment(buckets[GetBucket(value)], 1);
+			Increment(count, 1);
+			Increment(sum, value);
+			
+			if(value > max.load(std::memory_order_relaxed))
+				max.store(value, std::memory_order_relaxed);
+		}
+		
+		void QueryStatistics::Recorder::AtomicHistogram::AddTo(Histogram &histogram) const
+		{
+			for(size_t i = 0; i < Histogram::BucketCount; i ++)
+				histogram.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+			
+			histogram.count += count.load(std::memory_order_relaxed);
+			histogram.sum += sum.load(std::memory_order_relaxed);
+			histogram.max = std::max(histogram.max, max.load(std::memory_order_relaxed));
+		}
+		
+		QueryStatistics::Recorder::Recorder()
+		{
+			for(size_t i = 0; i < ResultCount; i ++)
+				_results[i].store(0, std::memory_order_relaxed);
+		}
+		
+		void QueryStatistics::Recorder::Record(const Sample &sample)
+		{
+			Increment(_results[sample.result], 1);
+			
+			_nearestPolyTime.Add(sample.nearestPolyTime);
+			_totalTime.Add(sample.nearestPolyTime + sample.findPathTime + sample.straightPathTime);
+			
+			if(sample.result == NoPolygon)
+				return;
+			
+			_findPathTime.Add(sample.findPathTime);
+			_straightPathTime.Add(sample.straightPathTime);
+			
+			_nodes.Add(sample.nodes);
+			_polygons.Add(sample.polygons);
+			_points.Add(sample.points);
+		}
+		
+		void QueryStatistics::Recorder::AddTo(Snapshot &snapshot) const
+		{
+			for(size_t i = 0; i < ResultCount; i ++)
+			{
+				uint64 results = _results[i].load(std::memory_order_relaxed);
+				
+				snapshot.results[i] += results;
+				snapshot.queries += results;
+			}
+			
+			_nearestPolyTime.AddTo(snapshot.nearestPolyTime);
+			_findPathTime.AddTo(snapshot.findPathTime);
+			_straightPathTime.AddTo(snapshot.straightPathTime);
+			_totalTime.AddTo(snapshot.totalTime);
+			
+			_nodes.AddTo(snapshot.nodes);
+			_polygons.AddTo(snapshot.polygons);
+			_points.AddTo(snapshot.points);
+		}
+		
+		
+		QueryStatistics::QueryStatistics() :
+		_enabled(true)
+		{}
+		
+		QueryStatistics::Snapshot QueryStatistics::GetSnapshot()
+		{
+			Snapshot snapshot;
+			_recorders.ForEach([&](const Recorder &recorder) {
+				recorder.AddTo(snapshot);
+			});
+			
+			return snapshot;
+		}
+	}
+}
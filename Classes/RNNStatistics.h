@@ -0,0 +1,156 @@
+//
+//  RNNStatistics.h
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __rayne_navigation__RNNStatistics__
+#define __rayne_navigation__RNNStatistics__
+
+#include <Rayne/Rayne.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "RNNThreadSlots.h"
+
+namespace RN
+{
+	namespace navigation
+	{
+		/// Path query statistics. Every thread recording into an instance gets its own Recorder, which
+		/// only that thread ever writes, so recording is a handful of relaxed atomic stores. Recorders
+		/// live as long as the instance, snapshots sum one per thread that ever recorded.
+		class QueryStatistics
+		{
+		public:
+			enum Result
+			{
+				Success,
+				Partial,
+				Truncated,
+				NoPolygon,
+				Failed,
+				
+				ResultCount
+			};
+			
+			/// Log2 buckets, bucket 0 holds zero and bucket n holds values in [2^(n-1), 2^n).
+			struct Histogram
+			{
+				static const size_t BucketCount = 32;
+				
+				Histogram();
+				
+				uint64 GetPercentile(float percentile) const;
+				uint64 GetAverage() const { return count ? sum / count : 0; }
+				
+				uint64 buckets[BucketCount];
+				uint64 count;
+				uint64 sum;
+				uint64 max;
+			};
+			
+			struct Sample
+			{
+				Sample();
+				
+				Result result;
+				
+				uint64 nearestPolyTime;
+				uint64 findPathTime;
+				uint64 straightPathTime;
+				
+				uint32 nodes;
+				uint32 polygons;
+				uint32 points;
+			};
+			
+			/// Times are in nanoseconds.
+			struct Snapshot
+			{
+				Snapshot();
+				
+				uint64 queries;
+				uint64 results[ResultCount];
+				
+				Histogram nearestPolyTime;
+				Histogram findPathTime;
+				Histogram straightPathTime;
+				Histogram totalTime;
+				
+				Histogram nodes;
+				Histogram polygons;
+				Histogram points;
+			};
+			
+			class Recorder
+			{
+			public:
+				Recorder();
+				
+				void Record(const Sample &sample);
+				void AddTo(Snapshot &snapshot) const;
+				
+			private:
+				struct AtomicHistogram
+				{
+					AtomicHistogram();
+					
+					void Add(uint64 value);
+					void AddTo(Histogram &histogram) const;
+					
+					std::atomic<uint64> buckets[Histogram::BucketCount];
+					std::atomic<uint64> count;
+					std::atomic<uint64> sum;
+					std::atomic<uint64> max;
+				};
+				
+				std::atomic<uint64> _results[ResultCount];
+				
+				AtomicHistogram _nearestPolyTime;
+				AtomicHistogram _findPathTime;
+				AtomicHistogram _straightPathTime;
+				AtomicHistogram _totalTime;
+				
+				AtomicHistogram _nodes;
+				AtomicHistogram _polygons;
+				AtomicHistogram _points;
+			};
+			
+			QueryStatistics();
+			
+			void SetEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+			bool IsEnabled() const { return _enabled.load(std::memory_order_relaxed); }
+			
+			/// Records into the calling thread's recorder.
+			void Record(const Sample &sample) { _recorders.Get()->Record(sample); }
+			Snapshot GetSnapshot();
+			
+			static uint64 GetTimestamp()
+			{
+				return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+			}
+			
+		private:
+			std::atomic<bool> _enabled;
+			ThreadSlots<Recorder> _recorders;
+		};
+	}
+}
+
+#endif /* defined(__rayne_navigation__RNNStatistics__) */
@@ -0,0 +1,64 @@
+//
+//  RNNThreadSlots.cpp
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RNNThreadSlots.h"
+
+#include <atomic>
+
+namespace RN
+{
+	namespace navigation
+	{
+		struct CachedSlot
+		{
+			uint64 id;
+			void *slot;
+		};
+		
+		// A thread rarely uses more than a mesh or two, misses fall back to the locked lookup
+		static const size_t CachedSlotCount = 8;
+		
+		static RNN_THREAD_LOCAL CachedSlot _cachedSlots[CachedSlotCount];
+		static RNN_THREAD_LOCAL size_t _nextCachedSlot;
+		
+		static std::atomic<uint64> _lastThreadSlotsID(0);
+		
+		ThreadSlotsBase::ThreadSlotsBase() :
+		_id(++ _lastThreadSlotsID)
+		{}
+		
+		void *ThreadSlotsBase::GetCachedSlot() const
+		{
+			for(size_t i = 0; i < CachedSlotCount; i ++)
+			{
+				if(_cachedSlots[i].id == _id)
+					return _cachedSlots[i].slot;
+			}
+			
+			return nullptr;
+		}
+		
+		void ThreadSlotsBase::SetCachedSlot(void *slot) const
+		{
+			CachedSlot &cached = _cachedSlots[_nextCachedSlot];
+			cached.id = _id;
+			cached.slot = slot;
+			
+			_nextCachedSlot = (_nextCachedSlot + 1) % CachedSlotCount;
+		}
+	}
+}
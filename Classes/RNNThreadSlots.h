@@ -0,0 +1,113 @@
+//
+//  RNNThreadSlots.h
+//  rayne-navigation
+//
+//  Copyright 2014 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __rayne_navigation__RNNThreadSlots__
+#define __rayne_navigation__RNNThreadSlots__
+
+#include <Rayne/Rayne.h>
+
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+	#define RNN_THREAD_LOCAL __declspec(thread)
+#else
+	#define RNN_THREAD_LOCAL __thread
+#endif
+
+namespace RN
+{
+	namespace navigation
+	{
+		/// Untyped part of ThreadSlots, owns the thread local lookup cache.
+		class ThreadSlotsBase
+		{
+		protected:
+			ThreadSlotsBase();
+			
+			void *GetCachedSlot() const;
+			void SetCachedSlot(void *slot) const;
+			
+		private:
+			// Unique per instance and never reused, so stale cache entries of destroyed instances never match
+			uint64 _id;
+		};
+		
+		/// One T per thread that ever asked for one, owned by the instance and destroyed with it.
+		/// A thread finds its slot through a small thread local cache, only the first lookup locks.
+		/// Slots are keyed by thread id, a new thread that gets the id of an exited one reuses its slot.
+		template<class T>
+		class ThreadSlots : public ThreadSlotsBase
+		{
+		public:
+			ThreadSlots()
+			{}
+			
+			~ThreadSlots()
+			{
+				for(auto &slot : _slots)
+					delete slot.second;
+			}
+			
+			T *Get()
+			{
+				T *slot = static_cast<T *>(GetCachedSlot());
+				if(slot)
+					return slot;
+				
+				std::thread::id thread = std::this_thread::get_id();
+				std::lock_guard<std::mutex> lock(_lock);
+				
+				for(auto &entry : _slots)
+				{
+					if(entry.first == thread)
+					{
+						slot = entry.second;
+						break;
+					}
+				}
+				
+				if(!slot)
+				{
+					slot = new T();
+					_slots.emplace_back(thread, slot);
+				}
+				
+				SetCachedSlot(slot);
+				return slot;
+			}
+			
+			/// Visits every slot while holding the lock, other threads may still be writing to theirs.
+			template<class F>
+			void ForEach(F &&function)
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				
+				for(auto &entry : _slots)
+					function(*entry.second);
+			}
+			
+		private:
+			std::mutex _lock;
+			std::vector<std::pair<std::thread::id, T *>> _slots;
+		};
+	}
+}
+
+#endif /* defined(__rayne_navigation__RNNThreadSlots__) */